@@ -15,6 +15,31 @@
 #include <ctype.h>
 #include "compat.h"
 
+#ifdef PG_BEFORE_090200
+int
+PQsetSingleRowMode(PGconn *conn)
+{
+	rb_raise(rb_eStandardError, 
+		"PQsetSingleRowMode not supported by this client version.");
+}
+#endif /* PG_BEFORE_090200 */
+
+#ifdef PG_BEFORE_080400
+int
+PQsetResultAttrs(PGresult *res, int numAttributes, PGresAttDesc *attDescs)
+{
+	rb_raise(rb_eStandardError, 
+		"PQsetResultAttrs not supported by this client version.");
+}
+
+int
+PQsetvalue(PGresult *res, int tup_num, int field_num, char *value, int len)
+{
+	rb_raise(rb_eStandardError, 
+		"PQsetvalue not supported by this client version.");
+}
+#endif /* PG_BEFORE_080400 */
+
 #ifdef PG_BEFORE_080300
 int
 PQconnectionNeedsPassword(PGconn *conn)
@@ -13,6 +13,14 @@
  * PostgreSQL, so I can't effectively use PG_VERSION_NUM
  * Instead, I create some #defines to help organization.
  */
+#ifndef HAVE_PQSETSINGLEROWMODE
+#define PG_BEFORE_090200
+#endif
+
+#ifndef HAVE_PQSETRESULTATTRS
+#define PG_BEFORE_080400
+#endif
+
 #ifndef HAVE_PQCONNECTIONUSEDPASSWORD
 #define PG_BEFORE_080300
 #endif
@@ -54,6 +62,27 @@
 #define PG_DIAG_INTERNAL_QUERY  'q'
 #endif /* PG_DIAG_INTERNAL_QUERY */
 
+#ifdef PG_BEFORE_090200
+#define PGRES_SINGLE_TUPLE 9
+int PQsetSingleRowMode(PGconn *conn);
+#endif /* PG_BEFORE_090200 */
+
+#ifdef PG_BEFORE_080400
+typedef struct pgresAttDesc
+{
+	char	   *name;
+	Oid			tableid;
+	int			columnid;
+	int			format;
+	Oid			typid;
+	int			typlen;
+	int			atttypmod;
+} PGresAttDesc;
+
+int PQsetResultAttrs(PGresult *res, int numAttributes, PGresAttDesc *attDescs);
+int PQsetvalue(PGresult *res, int tup_num, int field_num, char *value, int len);
+#endif /* PG_BEFORE_080400 */
+
 #ifdef PG_BEFORE_080300
 
 #ifndef HAVE_PG_ENCODING_TO_CHAR
@@ -75,11 +75,16 @@ desired_functions = %w(
 	lo_create
 	pg_encoding_to_char 
 	PQsetClientEncoding 
+	PQsetSingleRowMode
+	PQresultMemorySize
+	PQsetResultAttrs
 )
 
 if have_build_env
 	desired_functions.each(&method(:have_func))
-	$OBJS = ['pg.o','compat.o']
+	have_func('rb_gc_adjust_memory_usage', 'ruby.h')
+	have_func('rb_str_set_len', 'ruby.h')
+	$OBJS = ['pg.o','compat.o','typecast.o']
 	create_makefile("pg")
 else
 	puts 'Could not find PostgreSQL build environment (libraries & headers): Makefile not created'
@@ -18,6 +18,9 @@ $functions = %w[
     lo_create
     pg_encoding_to_char
     PQsetClientEncoding
+    PQsetSingleRowMode
+    PQresultMemorySize
+    PQsetResultAttrs
 ]
 
 # OS X compatibility
@@ -18,8 +18,88 @@
 
 static VALUE rb_cPGconn;
 static VALUE rb_cPGresult;
+static VALUE rb_cPGrow;
+static VALUE rb_cPGstatement;
 static VALUE rb_ePGError;
 
+/*
+ * How the values of a field are decoded: with _func_ if it is set,
+ * otherwise by calling the Ruby _proc_ with the String value if that
+ * isn't nil.
+ */
+typedef struct {
+	t_pg_decoder func;
+	VALUE proc;
+} t_pg_field_decoder;
+
+/*
+ * The state behind a PGresult object. _result_ is NULL once the
+ * result has been cleared. _owned_ is zero for results that belong
+ * to libpq (as passed to a notice receiver) and must not be freed.
+ */
+typedef struct {
+	PGresult *result;
+	int owned;
+	VALUE connection;     /* the PGconn that produced the result */
+	VALUE field_names;    /* cached hash keys, see pgresult_field_names() */
+	VALUE field_name_type;
+	VALUE type_map;
+	t_pg_field_decoder *decoders; /* one per field, NULL when not typecasting */
+	int ndecoders;
+	size_t memsize;       /* bytes reported to the GC, see result_memsize() */
+} t_pgresult;
+
+/*
+ * The state behind a PGrow object: a tuple of a PGresult.
+ */
+typedef struct {
+	VALUE result;
+	int tuple_num;
+} t_pgrow;
+
+/*
+ * The state behind a PGstatement object: the name of a statement 
+ * prepared on _connection_, and the result of describing it, which 
+ * holds the types of its fields and the decoders compiled for them.
+ * The parameter types are copied out of the description, which can
+ * be cleared from Ruby while parameters are being converted.
+ */
+typedef struct {
+	VALUE connection;
+	VALUE name;           /* frozen copy of the statement name */
+	VALUE description;    /* PGresult from PQdescribePrepared() */
+	int nparams;
+	Oid *param_types;
+} t_pgstatement;
+
+static ID id_string;
+static ID id_symbol;
+static ID id_builtin;
+static ID id_fields;
+static ID id_hstore;
+static ID id_call;
+static ID id_symbol_array;
+static ID id_hstore_array;
+static ID id_lock;
+static ID id_unlock;
+static ID id_replace;
+static ID id_delimiter;
+static ID id_quote;
+static ID id_header;
+static ID id_null;
+static ID id_typed;
+
+/* Keys of the bind parameter Hashes of #exec and friends */
+static VALUE sym_type;
+static VALUE sym_value;
+static VALUE sym_format;
+static VALUE sym_bytea;
+
+/* PGconn#type_catalog: the catalogs of the servers connected to, and
+ * the Mutex serializing their loading. */
+static VALUE type_catalogs;
+static VALUE type_catalog_lock;
+
 /* The following functions are part of libpq, but not
  * available from ruby-pg, because they are deprecated,
  * obsolete, or generally not useful:
@@ -51,6 +131,15 @@ static PGconn *get_pgconn(VALUE self);
 static VALUE pgconn_finish(VALUE self);
 static VALUE pgresult_clear(VALUE self);
 static VALUE pgresult_aref(VALUE self, VALUE index);
+static VALUE pgresult_value(t_pgresult *this, int tuple_num, int field_num);
+static VALUE pgresult_field_names(VALUE self);
+static void compile_type_map(t_pgresult *this, VALUE type_map);
+static void resolve_decoder(t_pg_field_decoder *decoder, VALUE spec, Oid type, 
+	int format, int integer_datetimes);
+static int pgresult_integer_datetimes(t_pgresult *this);
+static void mark_pgrow(t_pgrow *this);
+static void free_pgrow(t_pgrow *this);
+static VALUE pgstatement_new(VALUE rb_pgconn, VALUE name);
 
 static PQnoticeReceiver default_notice_receiver = NULL;
 static PQnoticeProcessor default_notice_processor = NULL;
@@ -98,10 +187,82 @@ free_pgconn(PGconn *conn)
 }
 
 static void
-free_pgresult(PGresult *result)
+mark_pgresult(t_pgresult *this)
 {
-	if(result != NULL)
-		PQclear(result);
+	int i;
+
+	rb_gc_mark(this->connection);
+	rb_gc_mark(this->field_names);
+	rb_gc_mark(this->field_name_type);
+	rb_gc_mark(this->type_map);
+	for(i = 0; i < this->ndecoders; i++)
+		rb_gc_mark(this->decoders[i].proc);
+}
+
+/*
+ * Tells the GC about memory held outside of the ruby heap by libpq
+ * results, so that large results make it run sooner. Rubies without
+ * rb_gc_adjust_memory_usage() get a similar effect from a GC started
+ * whenever the memory held by live results has doubled since the 
+ * last one we started (and is over PGRESULT_MALLOC_LIMIT), so the 
+ * number of collections grows with the log of the memory held, and
+ * results that are cleared as soon as they are read, as by 
+ * PGconn#stream, never start one.
+ */
+#define PGRESULT_MALLOC_LIMIT (8 * 1024 * 1024)
+
+static void
+adjust_result_memory_usage(long diff)
+{
+#ifdef HAVE_RB_GC_ADJUST_MEMORY_USAGE
+	rb_gc_adjust_memory_usage(diff);
+#else
+	static long live = 0, live_after_gc = 0;
+
+	live += diff;
+	if(diff > 0 && live > PGRESULT_MALLOC_LIMIT && live > 2 * live_after_gc) {
+		rb_gc();
+		/* results freed by the collection have been subtracted */
+		live_after_gc = live;
+	}
+#endif
+}
+
+/*
+ * Returns the number of bytes held by _result_. Older versions
+ * of libpq can't tell, so it's estimated from the value lengths
+ * and the size of libpq's per-value bookkeeping.
+ */
+static size_t
+result_memsize(PGresult *result)
+{
+#ifdef HAVE_PQRESULTMEMORYSIZE
+	return PQresultMemorySize(result);
+#else
+	int ntuples = PQntuples(result);
+	int nfields = PQnfields(result);
+	int tuple_num, field_num;
+	size_t size = sizeof(char *) * 16 + 
+		nfields * (sizeof(char *) * 4 + NAMEDATALEN);
+
+	size += (size_t)ntuples * nfields * (sizeof(char *) + sizeof(int) + 1);
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		for(field_num = 0; field_num < nfields; field_num++)
+			size += PQgetlength(result, tuple_num, field_num);
+	}
+	return size;
+#endif
+}
+
+static void
+free_pgresult(t_pgresult *this)
+{
+	if(this->result != NULL && this->owned) {
+		PQclear(this->result);
+		adjust_result_memory_usage(-(long)this->memsize);
+	}
+	xfree(this->decoders);
+	xfree(this);
 }
 
 static PGconn*
@@ -113,19 +274,70 @@ get_pgconn(VALUE self)
 	return conn;
 }
 
+static t_pgresult*
+get_pgresult_data(VALUE self)
+{
+	t_pgresult *this;
+	Data_Get_Struct(self, t_pgresult, this);
+	if (this->result == NULL) rb_raise(rb_ePGError, "result has been cleared");
+	return this;
+}
+
 static PGresult*
 get_pgresult(VALUE self)
 {
-	PGresult *result;
-	Data_Get_Struct(self, PGresult, result);
-	if (result == NULL) rb_raise(rb_ePGError, "result has been cleared");
-	return result;
+	return get_pgresult_data(self)->result;
+}
+
+static VALUE
+wrap_pgresult(PGresult *result, VALUE rb_pgconn, int owned)
+{
+	t_pgresult *this;
+	VALUE self = Data_Make_Struct(rb_cPGresult, t_pgresult, 
+		mark_pgresult, free_pgresult, this);
+	this->result = result;
+	this->owned = owned;
+	this->connection = rb_pgconn;
+	this->field_names = Qnil;
+	this->field_name_type = ID2SYM(id_string);
+	this->type_map = Qnil;
+	this->decoders = NULL;
+	this->ndecoders = 0;
+	this->memsize = 0;
+	if(result != NULL && owned) {
+		this->memsize = result_memsize(result);
+		adjust_result_memory_usage((long)this->memsize);
+	}
+	return self;
 }
 
+/*
+ * Wraps a result returned by libpq on the connection _rb_pgconn_.
+ * If the connection has a type map (see PGconn#type_map), the result
+ * takes it, to be compiled into decoders by pgresult_decoders() once
+ * a value is decoded: results that are never read, such as command
+ * results, don't pay for it.
+ */
 static VALUE
-new_pgresult(PGresult *result)
+new_pgresult(PGresult *result, VALUE rb_pgconn)
+{
+	VALUE self = wrap_pgresult(result, rb_pgconn, 1);
+
+	if(result != NULL && PQnfields(result) > 0 && !NIL_P(rb_pgconn))
+		((t_pgresult *)DATA_PTR(self))->type_map = rb_iv_get(rb_pgconn, "@type_map");
+	return self;
+}
+
+/*
+ * Returns the decoders of _this_, compiling the type map it got from
+ * its connection on first use, or NULL if it has no type map.
+ */
+static t_pg_field_decoder *
+pgresult_decoders(t_pgresult *this)
 {
-	return Data_Wrap_Struct(rb_cPGresult, NULL, free_pgresult, result);
+	if(this->decoders == NULL && !NIL_P(this->type_map))
+		compile_type_map(this, this->type_map);
+	return this->decoders;
 }
 
 /*
@@ -137,8 +349,10 @@ pgresult_check(VALUE rb_pgconn, VALUE rb_pgresult)
 {
 	VALUE error;
 	PGconn *conn = get_pgconn(rb_pgconn);
+	t_pgresult *this;
 	PGresult *result;
-	Data_Get_Struct(rb_pgresult, PGresult, result);
+	Data_Get_Struct(rb_pgresult, t_pgresult, this);
+	result = this->result;
 
 	if(result == NULL)
 	{
@@ -149,6 +363,7 @@ pgresult_check(VALUE rb_pgconn, VALUE rb_pgresult)
 		switch (PQresultStatus(result))
 		{
 		case PGRES_TUPLES_OK:
+		case PGRES_SINGLE_TUPLE:
 		case PGRES_COPY_OUT:
 		case PGRES_COPY_IN:
 		case PGRES_EMPTY_QUERY:
@@ -190,7 +405,7 @@ notice_receiver_proxy(void *arg, const PGresult *result)
 
 	if ((proc = rb_iv_get(self, "@notice_receiver")) != Qnil) {
 		rb_funcall(proc, rb_intern("call"), 1, 
-			Data_Wrap_Struct(rb_cPGresult, NULL, NULL, (PGresult*)result));
+			wrap_pgresult((PGresult*)result, self, 0));
 	}
 	return;
 }
@@ -874,6 +1089,205 @@ pgconn_connection_used_password(VALUE self)
 //TODO get_ssl
 
 
+/*
+ * Converts the +:value+ of a bind parameter to the String sent to
+ * the server: Hashes are encoded as hstore literals, Arrays as array
+ * literals, anything else with #to_s.
+ */
+static VALUE
+param_value_string(VALUE value)
+{
+	switch(TYPE(value)) {
+	case T_HASH:
+		return pg_text_enc_hstore(value);
+	case T_ARRAY:
+		return pg_text_enc_array(value);
+	default:
+		return rb_obj_as_string(value);
+	}
+}
+
+/*
+ * Bind parameters marshalled for PQexecParams() and friends, shared 
+ * by #exec, #exec_prepared, #send_query and #send_query_prepared.
+ *
+ * Lists of up to PARAMS_ON_STACK parameters are kept in the arrays
+ * of the struct itself, which lives on the caller's stack; longer 
+ * ones in a Ruby String, so that nothing needs freeing if marshalling
+ * raises. The Strings the values point into are pinned the same way:
+ * in _small_pins_, which the GC finds by scanning the stack, or in 
+ * the Array _pins_, which is referenced from the stack.
+ *
+ * Integers, Floats, true and false, Times and Dates are formatted
+ * into the _scratch_ space of their parameter (PG_ENC_BUFSIZE bytes
+ * each) without creating a String.
+ */
+#define PARAMS_ON_STACK 16
+
+typedef struct {
+	int nparams;
+	Oid *types;
+	char **values;
+	int *lengths;
+	int *formats;
+	char *scratch;
+	VALUE pins;
+	Oid small_types[PARAMS_ON_STACK];
+	char *small_values[PARAMS_ON_STACK];
+	int small_lengths[PARAMS_ON_STACK];
+	int small_formats[PARAMS_ON_STACK];
+	VALUE small_pins[PARAMS_ON_STACK];
+	char small_scratch[PARAMS_ON_STACK * PG_ENC_BUFSIZE];
+} t_pg_params;
+
+static void
+pin_param(t_pg_params *p, int i, VALUE str)
+{
+	if(NIL_P(p->pins))
+		p->small_pins[i] = str;
+	else
+		rb_ary_store(p->pins, i, str);
+}
+
+/*
+ * Formats _value_ as parameter _i_ of _p_ if it is of one of the 
+ * types handled natively, and sets the parameter's type to match
+ * unless it was given. Numbers are left for the server to type,
+ * as their text form used to be. Returns 0 for other values.
+ */
+static int
+encode_param(t_pg_params *p, int i, VALUE value)
+{
+	char *out = p->scratch + i * PG_ENC_BUFSIZE;
+	Oid type = 0;
+	int len;
+
+	switch(TYPE(value)) {
+	case T_FIXNUM:
+		len = pg_text_enc_integer(FIX2LONG(value), out);
+		break;
+	case T_FLOAT:
+		len = pg_text_enc_float(NUM2DBL(value), out);
+		break;
+	case T_TRUE:
+	case T_FALSE:
+		type = BOOLOID;
+		len = value == Qtrue ? 4 : 5;
+		memcpy(out, value == Qtrue ? "true" : "false", len + 1);
+		break;
+	case T_DATA:
+	case T_OBJECT:
+		if(rb_obj_is_kind_of(value, rb_cTime)) {
+			type = TIMESTAMPTZOID;
+			len = pg_text_enc_time(value, out);
+		}
+		else {
+			type = DATEOID;
+			len = pg_text_enc_date(value, out);
+		}
+		break;
+	default:
+		len = -1;
+	}
+	if(len < 0)
+		return 0;
+	p->values[i] = out;
+	p->lengths[i] = len;
+	if(p->types[i] == 0)
+		p->types[i] = type;
+	return 1;
+}
+
+/*
+ * The oid for the +:type+ of a bind parameter: an Integer, or the
+ * Symbol name of a built-in type in PGconn::PARAM_TYPES, such as 
+ * +:int4+, +:text+, +:bytea+ or the array types +:_int4+ and 
+ * <tt>:"int4[]"</tt>.
+ */
+static Oid
+param_type(VALUE type)
+{
+	Oid oid;
+
+	if(!SYMBOL_P(type))
+		return NUM2UINT(type);
+	oid = pg_param_type_oid(rb_id2name(SYM2ID(type)));
+	if(oid == InvalidOid)
+		rb_raise(rb_eArgError, "unknown type %s", rb_id2name(SYM2ID(type)));
+	return oid;
+}
+
+/*
+ * Fills _p_ from _params_, an Array of bind parameters as described
+ * for #exec. _known_types_ are the parameter types of the prepared
+ * statement they are for, if known: Strings for its +bytea+ parameters
+ * are then sent in binary, as if given with <tt>:type => :bytea</tt>.
+ */
+static void
+marshal_params(t_pg_params *p, VALUE params, const Oid *known_types)
+{
+	VALUE param, value, type, format, buffer;
+	char *mem;
+	int i, n;
+
+	n = p->nparams = (int)RARRAY_LEN(params);
+	p->pins = Qnil;
+	if(n <= PARAMS_ON_STACK) {
+		p->types = p->small_types;
+		p->values = p->small_values;
+		p->lengths = p->small_lengths;
+		p->formats = p->small_formats;
+		p->scratch = p->small_scratch;
+	}
+	else {
+		/* pointers first, to keep every array aligned */
+		buffer = rb_str_new(NULL, n * (sizeof(char *) + sizeof(Oid) + 
+			2 * sizeof(int) + PG_ENC_BUFSIZE));
+		p->pins = rb_ary_new2(n + 1);
+		rb_ary_store(p->pins, n, buffer);
+		mem = RSTRING_PTR(buffer);
+		p->values = (char **)mem;
+		p->types = (Oid *)(mem + n * sizeof(char *));
+		p->lengths = (int *)(p->types + n);
+		p->formats = p->lengths + n;
+		p->scratch = (char *)(p->formats + n);
+	}
+
+	for(i = 0; i < n; i++) {
+		param = rb_ary_entry(params, i);
+		type = format = Qnil;
+		if(TYPE(param) == T_HASH) {
+			value = rb_hash_aref(param, sym_value);
+			type = rb_hash_aref(param, sym_type);
+			format = rb_hash_aref(param, sym_format);
+		}
+		else {
+			value = param;
+		}
+
+		p->types[i] = NIL_P(type) ? 0 : param_type(type);
+		if(!NIL_P(format))
+			p->formats[i] = NUM2INT(format);
+		else if(TYPE(value) == T_STRING && (type == sym_bytea || 
+				(NIL_P(type) && known_types != NULL && 
+				known_types[i] == BYTEAOID)))
+			p->formats[i] = 1;
+		else
+			p->formats[i] = 0;
+		if(NIL_P(value)) {
+			p->values[i] = NULL;
+			p->lengths[i] = 0;
+		}
+		else if(p->formats[i] != 0 || !encode_param(p, i, value)) {
+			if(TYPE(value) != T_STRING)
+				value = param_value_string(value);
+			pin_param(p, i, value);
+			p->values[i] = RSTRING_PTR(value);
+			p->lengths[i] = (int)RSTRING_LEN(value);
+		}
+	}
+}
+
 /*
  * call-seq:
  *    conn.exec(sql [, params, result_format ] ) -> PGresult
@@ -887,6 +1301,8 @@ pgconn_connection_used_password(VALUE self)
  *   a hash of the form:
  *     {:value  => String (value of bind parameter)
  *      :type   => Fixnum (oid of type of bind parameter)
+ *                 or Symbol (a type name in PARAM_TYPES, e.g. :int4,
+ *                 :text, :numeric or :_int4 for int4[])
  *      :format => Fixnum (0 for text, 1 for binary)
  *     }
  *   or, it may be a String. If it is a string, that is equivalent to the hash:
@@ -895,6 +1311,16 @@ pgconn_connection_used_password(VALUE self)
  * PostgreSQL bind parameters are represented as $1, $1, $2, etc.,
  * inside the SQL query. The 0th element of the +params+ array is bound
  * to $1, the 1st element is bound to $2, etc. +nil+ is treated as +NULL+.
+ * A Hash given as a +:value+ is sent as an +hstore+ literal. An Array
+ * is sent as an array literal, so that for example
+ * <tt>conn.exec("SELECT * FROM t WHERE id = ANY($1)", [[1, 2, 3]])</tt>
+ * works; the type of the array is left for the server to infer.
+ * true and false are sent as +boolean+, Times as +timestamptz+ (in UTC)
+ * and Dates as +date+, unless a +:type+ is given. A String with 
+ * <tt>:type => :bytea</tt> and no +:format+ is sent as is, in binary,
+ * so binary data needs no #escape_bytea:
+ *   conn.exec("INSERT INTO images (data) VALUES ($1)",
+ *     [{:value => File.read("photo.jpg"), :type => :bytea}])
  * 
  * If the types are not specified, they will be inferred by PostgreSQL.
  * Instead of specifying type oids, it's recommended to simply add
@@ -912,16 +1338,7 @@ pgconn_exec(int argc, VALUE *argv, VALUE self)
 	PGresult *result = NULL;
 	VALUE rb_pgresult;
 	VALUE command, params, in_res_fmt;
-	VALUE param, param_type, param_value, param_format;
-	VALUE param_value_tmp;
-	VALUE sym_type, sym_value, sym_format;
-	VALUE gc_array;
-	int i=0;
-	int nParams;
-	Oid *paramTypes;
-	char ** paramValues;
-	int *paramLengths;
-	int *paramFormats;
+	t_pg_params p;
 	int resultFormat;
 
 	rb_scan_args(argc, argv, "12", &command, &params, &in_res_fmt);
@@ -931,7 +1348,7 @@ pgconn_exec(int argc, VALUE *argv, VALUE self)
 	/* If called with no parameters, use PQexec */
 	if(NIL_P(params)) {
 		result = PQexec(conn, StringValuePtr(command));
-		rb_pgresult = new_pgresult(result);
+		rb_pgresult = new_pgresult(result, self);
 		pgresult_check(self, rb_pgresult);
 		if (rb_block_given_p()) {
 			return rb_ensure(yield_pgresult, rb_pgresult, 
@@ -952,70 +1369,11 @@ pgconn_exec(int argc, VALUE *argv, VALUE self)
 		resultFormat = NUM2INT(in_res_fmt);
 	}
 
-	gc_array = rb_ary_new();
-	rb_gc_register_address(&gc_array);
-	sym_type = ID2SYM(rb_intern("type"));
-	sym_value = ID2SYM(rb_intern("value"));
-	sym_format = ID2SYM(rb_intern("format"));
-	nParams = RARRAY_LEN(params);
-	paramTypes = ALLOC_N(Oid, nParams); 
-	paramValues = ALLOC_N(char *, nParams);
-	paramLengths = ALLOC_N(int, nParams);
-	paramFormats = ALLOC_N(int, nParams);
-	for(i = 0; i < nParams; i++) {
-		param = rb_ary_entry(params, i);
-		if (TYPE(param) == T_HASH) {
-			param_type = rb_hash_aref(param, sym_type);
-			param_value_tmp = rb_hash_aref(param, sym_value);
-			if(param_value_tmp == Qnil)
-				param_value = param_value_tmp;
-			else
-				param_value = rb_obj_as_string(param_value_tmp);
-			param_format = rb_hash_aref(param, sym_format);
-		}
-		else {
-			param_type = Qnil;
-			if(param == Qnil)
-				param_value = param;
-			else
-				param_value = rb_obj_as_string(param);
-			param_format = Qnil;
-		}
-
-		if(param_type == Qnil)
-			paramTypes[i] = 0;
-		else
-			paramTypes[i] = NUM2INT(param_type);
-
-		if(param_value == Qnil) {
-			paramValues[i] = NULL;
-			paramLengths[i] = 0;
-		}
-		else {
-			Check_Type(param_value, T_STRING);
-			/* make sure param_value doesn't get freed by the GC */
-			rb_ary_push(gc_array, param_value);
-			paramValues[i] = StringValuePtr(param_value);
-			paramLengths[i] = RSTRING_LEN(param_value);
-		}
-
-		if(param_format == Qnil)
-			paramFormats[i] = 0;
-		else
-			paramFormats[i] = NUM2INT(param_format);
-	}
-	
-	result = PQexecParams(conn, StringValuePtr(command), nParams, paramTypes, 
-		(const char * const *)paramValues, paramLengths, paramFormats, resultFormat);
-
-	rb_gc_unregister_address(&gc_array);
+	marshal_params(&p, params, NULL);
+	result = PQexecParams(conn, StringValuePtr(command), p.nparams, p.types, 
+		(const char * const *)p.values, p.lengths, p.formats, resultFormat);
 
-	free(paramTypes);
-	free(paramValues);
-	free(paramLengths);
-	free(paramFormats);
-
-	rb_pgresult = new_pgresult(result);
+	rb_pgresult = new_pgresult(result, self);
 	pgresult_check(self, rb_pgresult);
 	if (rb_block_given_p()) {
 		return rb_ensure(yield_pgresult, rb_pgresult, 
@@ -1043,6 +1401,8 @@ pgconn_exec(int argc, VALUE *argv, VALUE self)
  * 
  * PostgreSQL bind parameters are represented as $1, $1, $2, etc.,
  * inside the SQL query.
+ *
+ * See also #prepare_statement.
  */
 static VALUE
 pgconn_prepare(int argc, VALUE *argv, VALUE self)
@@ -1078,11 +1438,29 @@ pgconn_prepare(int argc, VALUE *argv, VALUE self)
 
 	free(paramTypes);
 
-	rb_pgresult = new_pgresult(result);
+	rb_pgresult = new_pgresult(result, self);
 	pgresult_check(self, rb_pgresult);
 	return rb_pgresult;
 }
 
+/*
+ * call-seq:
+ *    conn.prepare_statement(stmt_name, sql [, param_types ] ) -> PGstatement
+ *
+ * Prepares _sql_ as #prepare does, and returns a PGstatement for 
+ * executing it.
+ *
+ * For example:
+ *    stmt = conn.prepare_statement("find_user", "SELECT * FROM users WHERE id = $1")
+ *    stmt.exec(42)
+ */
+static VALUE
+pgconn_prepare_statement(int argc, VALUE *argv, VALUE self)
+{
+	pgresult_clear(pgconn_prepare(argc, argv, self));
+	return pgstatement_new(self, argv[0]);
+}
+
 /*
  * call-seq:
  *    conn.exec_prepared(statement_name [, params, result_format ] ) -> PGresult
@@ -1103,6 +1481,16 @@ pgconn_prepare(int argc, VALUE *argv, VALUE self)
  * PostgreSQL bind parameters are represented as $1, $1, $2, etc.,
  * inside the SQL query. The 0th element of the +params+ array is bound
  * to $1, the 1st element is bound to $2, etc. +nil+ is treated as +NULL+.
+ * A Hash given as a +:value+ is sent as an +hstore+ literal. An Array
+ * is sent as an array literal, so that for example
+ * <tt>conn.exec("SELECT * FROM t WHERE id = ANY($1)", [[1, 2, 3]])</tt>
+ * works; the type of the array is left for the server to infer.
+ * true and false are sent as +boolean+, Times as +timestamptz+ (in UTC)
+ * and Dates as +date+, unless a +:type+ is given. A String with 
+ * <tt>:type => :bytea</tt> and no +:format+ is sent as is, in binary,
+ * so binary data needs no #escape_bytea:
+ *   conn.exec("INSERT INTO images (data) VALUES ($1)",
+ *     [{:value => File.read("photo.jpg"), :type => :bytea}])
  *
  * The optional +result_format+ should be 0 for text results, 1
  * for binary.
@@ -1114,24 +1502,14 @@ pgconn_exec_prepared(int argc, VALUE *argv, VALUE self)
 	PGresult *result = NULL;
 	VALUE rb_pgresult;
 	VALUE name, params, in_res_fmt;
-	VALUE param, param_value, param_format;
-	VALUE param_value_tmp;
-	VALUE sym_value, sym_format;
-	VALUE gc_array;
-	int i = 0;
-	int nParams;
-	char ** paramValues;
-	int *paramLengths;
-	int *paramFormats;
+	t_pg_params p;
 	int resultFormat;
 
-
 	rb_scan_args(argc, argv, "12", &name, &params, &in_res_fmt);
 	Check_Type(name, T_STRING);
 
 	if(NIL_P(params)) {
 		params = rb_ary_new2(0);
-		resultFormat = 0;
 	}
 	else {
 		Check_Type(params, T_ARRAY);
@@ -1144,60 +1522,12 @@ pgconn_exec_prepared(int argc, VALUE *argv, VALUE self)
 		resultFormat = NUM2INT(in_res_fmt);
 	}
 
-	gc_array = rb_ary_new();
-	rb_gc_register_address(&gc_array);
-	sym_value = ID2SYM(rb_intern("value"));
-	sym_format = ID2SYM(rb_intern("format"));
-	nParams = RARRAY_LEN(params);
-	paramValues = ALLOC_N(char *, nParams);
-	paramLengths = ALLOC_N(int, nParams);
-	paramFormats = ALLOC_N(int, nParams);
-	for(i = 0; i < nParams; i++) {
-		param = rb_ary_entry(params, i);
-		if (TYPE(param) == T_HASH) {
-			param_value_tmp = rb_hash_aref(param, sym_value);
-			if(param_value_tmp == Qnil)
-				param_value = param_value_tmp;
-			else
-				param_value = rb_obj_as_string(param_value_tmp);
-			param_format = rb_hash_aref(param, sym_format);
-		}
-		else {
-			if(param == Qnil)
-				param_value = param;
-			else
-				param_value = rb_obj_as_string(param);
-			param_format = INT2NUM(0);
-		}
-		if(param_value == Qnil) {
-			paramValues[i] = NULL;
-			paramLengths[i] = 0;
-		}
-		else {
-			Check_Type(param_value, T_STRING);
-			/* make sure param_value doesn't get freed by the GC */
-			rb_ary_push(gc_array, param_value);
-			paramValues[i] = StringValuePtr(param_value);
-			paramLengths[i] = RSTRING_LEN(param_value);
-		}
-
-		if(param_format == Qnil)
-			paramFormats[i] = 0;
-		else
-			paramFormats[i] = NUM2INT(param_format);
-	}
-	
-	result = PQexecPrepared(conn, StringValuePtr(name), nParams, 
-		(const char * const *)paramValues, paramLengths, paramFormats, 
+	marshal_params(&p, params, NULL);
+	result = PQexecPrepared(conn, StringValuePtr(name), p.nparams, 
+		(const char * const *)p.values, p.lengths, p.formats, 
 		resultFormat);
 
-	rb_gc_unregister_address(&gc_array);
-
-	free(paramValues);
-	free(paramLengths);
-	free(paramFormats);
-
-	rb_pgresult = new_pgresult(result);
+	rb_pgresult = new_pgresult(result, self);
 	pgresult_check(self, rb_pgresult);
 	if (rb_block_given_p()) {
 		return rb_ensure(yield_pgresult, rb_pgresult, 
@@ -1228,7 +1558,7 @@ pgconn_describe_prepared(VALUE self, VALUE stmt_name)
 		stmt = StringValuePtr(stmt_name);
 	}
 	result = PQdescribePrepared(conn, stmt);
-	rb_pgresult = new_pgresult(result);
+	rb_pgresult = new_pgresult(result, self);
 	pgresult_check(self, rb_pgresult);
 	return rb_pgresult;
 }
@@ -1256,7 +1586,7 @@ pgconn_describe_portal(self, stmt_name)
 		stmt = StringValuePtr(stmt_name);
 	}
 	result = PQdescribePortal(conn, stmt);
-	rb_pgresult = new_pgresult(result);
+	rb_pgresult = new_pgresult(result, self);
 	pgresult_check(self, rb_pgresult);
 	return rb_pgresult;
 }
@@ -1284,7 +1614,7 @@ pgconn_make_empty_pgresult(VALUE self, VALUE status)
 	VALUE rb_pgresult;
 	PGconn *conn = get_pgconn(self);
 	result = PQmakeEmptyPGresult(conn, NUM2INT(status));
-	rb_pgresult = new_pgresult(result);
+	rb_pgresult = new_pgresult(result, self);
 	pgresult_check(self, rb_pgresult);
 	return rb_pgresult;
 }
@@ -1354,8 +1684,9 @@ pgconn_s_escape(VALUE self, VALUE string)
  * #escape_bytea performs this operation, escaping only the minimally required 
  * bytes.
  * 
- * Consider using exec_params, which avoids the need for passing values inside of 
- * SQL commands.
+ * Consider using exec with <tt>:type => :bytea</tt> bind parameters, which 
+ * sends binary data without escaping it and without passing values inside 
+ * of SQL commands.
  */
 static VALUE
 pgconn_s_escape_bytea(VALUE self, VALUE str)
@@ -1408,6 +1739,43 @@ pgconn_s_unescape_bytea(VALUE self, VALUE str)
 	return ret;
 }
 
+/*
+ * call-seq:
+ *   PGconn.encode_hstore( hash ) -> String
+ *
+ * Returns _hash_ as an +hstore+ literal, such as 
+ * <tt>"k"=>"v", "k2"=>NULL</tt>. Keys and values are converted with 
+ * #to_s, and +nil+ values become +NULL+. A Hash passed as the 
+ * +:value+ of a bind parameter is encoded this way automatically.
+ */
+static VALUE
+pgconn_s_encode_hstore(VALUE self, VALUE hash)
+{
+	VALUE ret = pg_text_enc_hstore(hash);
+	OBJ_INFECT(ret, hash);
+	return ret;
+}
+
+/*
+ * call-seq:
+ *   PGconn.decode_hstore( string ) -> Hash
+ *
+ * Parses the text representation of an +hstore+ into a Hash of 
+ * Strings, with +nil+ for +NULL+ values. The reverse of 
+ * #encode_hstore. See also PGresult#hstore_values.
+ */
+static VALUE
+pgconn_s_decode_hstore(VALUE self, VALUE str)
+{
+	VALUE ret;
+
+	Check_Type(str, T_STRING);
+	ret = pg_text_dec_hstore(RSTRING_PTR(str), RSTRING_LEN(str));
+	if(ret == Qundef)
+		rb_raise(rb_eArgError, "malformed hstore literal");
+	return ret;
+}
+
 /*
  * call-seq:
  *    conn.send_query(sql [, params, result_format ] ) -> nil
@@ -1421,6 +1789,8 @@ pgconn_s_unescape_bytea(VALUE self, VALUE str)
  *   a hash of the form:
  *     {:value  => String (value of bind parameter)
  *      :type   => Fixnum (oid of type of bind parameter)
+ *                 or Symbol (a type name in PARAM_TYPES, e.g. :int4,
+ *                 :text, :numeric or :_int4 for int4[])
  *      :format => Fixnum (0 for text, 1 for binary)
  *     }
  *   or, it may be a String. If it is a string, that is equivalent to the hash:
@@ -1429,6 +1799,16 @@ pgconn_s_unescape_bytea(VALUE self, VALUE str)
  * PostgreSQL bind parameters are represented as $1, $1, $2, etc.,
  * inside the SQL query. The 0th element of the +params+ array is bound
  * to $1, the 1st element is bound to $2, etc. +nil+ is treated as +NULL+.
+ * A Hash given as a +:value+ is sent as an +hstore+ literal. An Array
+ * is sent as an array literal, so that for example
+ * <tt>conn.exec("SELECT * FROM t WHERE id = ANY($1)", [[1, 2, 3]])</tt>
+ * works; the type of the array is left for the server to infer.
+ * true and false are sent as +boolean+, Times as +timestamptz+ (in UTC)
+ * and Dates as +date+, unless a +:type+ is given. A String with 
+ * <tt>:type => :bytea</tt> and no +:format+ is sent as is, in binary,
+ * so binary data needs no #escape_bytea:
+ *   conn.exec("INSERT INTO images (data) VALUES ($1)",
+ *     [{:value => File.read("photo.jpg"), :type => :bytea}])
  * 
  * If the types are not specified, they will be inferred by PostgreSQL.
  * Instead of specifying type oids, it's recommended to simply add
@@ -1445,17 +1825,8 @@ pgconn_send_query(int argc, VALUE *argv, VALUE self)
 	PGconn *conn = get_pgconn(self);
 	int result;
 	VALUE command, params, in_res_fmt;
-	VALUE param, param_type, param_value, param_format;
-	VALUE param_value_tmp;
-	VALUE sym_type, sym_value, sym_format;
-	VALUE gc_array;
 	VALUE error;
-	int i=0;
-	int nParams;
-	Oid *paramTypes;
-	char ** paramValues;
-	int *paramLengths;
-	int *paramFormats;
+	t_pg_params p;
 	int resultFormat;
 
 	rb_scan_args(argc, argv, "12", &command, &params, &in_res_fmt);
@@ -1483,68 +1854,9 @@ pgconn_send_query(int argc, VALUE *argv, VALUE self)
 		resultFormat = NUM2INT(in_res_fmt);
 	}
 
-	gc_array = rb_ary_new();
-	rb_gc_register_address(&gc_array);
-	sym_type = ID2SYM(rb_intern("type"));
-	sym_value = ID2SYM(rb_intern("value"));
-	sym_format = ID2SYM(rb_intern("format"));
-	nParams = RARRAY_LEN(params);
-	paramTypes = ALLOC_N(Oid, nParams); 
-	paramValues = ALLOC_N(char *, nParams);
-	paramLengths = ALLOC_N(int, nParams);
-	paramFormats = ALLOC_N(int, nParams);
-	for(i = 0; i < nParams; i++) {
-		param = rb_ary_entry(params, i);
-		if (TYPE(param) == T_HASH) {
-			param_type = rb_hash_aref(param, sym_type);
-			param_value_tmp = rb_hash_aref(param, sym_value);
-			if(param_value_tmp == Qnil)
-				param_value = param_value_tmp;
-			else
-				param_value = rb_obj_as_string(param_value_tmp);
-			param_format = rb_hash_aref(param, sym_format);
-		}
-		else {
-			param_type = INT2NUM(0);
-			if(param == Qnil)
-				param_value = param;
-			else
-				param_value = rb_obj_as_string(param);
-			param_format = INT2NUM(0);
-		}
-
-		if(param_type == Qnil)
-			paramTypes[i] = 0;
-		else
-			paramTypes[i] = NUM2INT(param_type);
-
-		if(param_value == Qnil) {
-			paramValues[i] = NULL;
-			paramLengths[i] = 0;
-		}
-		else {
-			Check_Type(param_value, T_STRING);
-			/* make sure param_value doesn't get freed by the GC */
-			rb_ary_push(gc_array, param_value);
-			paramValues[i] = StringValuePtr(param_value);
-			paramLengths[i] = RSTRING_LEN(param_value);
-		}
-
-		if(param_format == Qnil)
-			paramFormats[i] = 0;
-		else
-			paramFormats[i] = NUM2INT(param_format);
-	}
-	
-	result = PQsendQueryParams(conn, StringValuePtr(command), nParams, paramTypes, 
-		(const char * const *)paramValues, paramLengths, paramFormats, resultFormat);
-
-	rb_gc_unregister_address(&gc_array);	
-
-	free(paramTypes);
-	free(paramValues);
-	free(paramLengths);
-	free(paramFormats);
+	marshal_params(&p, params, NULL);
+	result = PQsendQueryParams(conn, StringValuePtr(command), p.nparams, p.types, 
+		(const char * const *)p.values, p.lengths, p.formats, resultFormat);
 
 	if(result == 0) {
 		error = rb_exc_new2(rb_ePGError, PQerrorMessage(conn));
@@ -1637,6 +1949,16 @@ pgconn_send_prepare(int argc, VALUE *argv, VALUE self)
  * PostgreSQL bind parameters are represented as $1, $1, $2, etc.,
  * inside the SQL query. The 0th element of the +params+ array is bound
  * to $1, the 1st element is bound to $2, etc. +nil+ is treated as +NULL+.
+ * A Hash given as a +:value+ is sent as an +hstore+ literal. An Array
+ * is sent as an array literal, so that for example
+ * <tt>conn.exec("SELECT * FROM t WHERE id = ANY($1)", [[1, 2, 3]])</tt>
+ * works; the type of the array is left for the server to infer.
+ * true and false are sent as +boolean+, Times as +timestamptz+ (in UTC)
+ * and Dates as +date+, unless a +:type+ is given. A String with 
+ * <tt>:type => :bytea</tt> and no +:format+ is sent as is, in binary,
+ * so binary data needs no #escape_bytea:
+ *   conn.exec("INSERT INTO images (data) VALUES ($1)",
+ *     [{:value => File.read("photo.jpg"), :type => :bytea}])
  *
  * The optional +result_format+ should be 0 for text results, 1
  * for binary.
@@ -1647,16 +1969,8 @@ pgconn_send_query_prepared(int argc, VALUE *argv, VALUE self)
 	PGconn *conn = get_pgconn(self);
 	int result;
 	VALUE name, params, in_res_fmt;
-	VALUE param, param_value, param_format;
-	VALUE param_value_tmp;
-	VALUE sym_value, sym_format;
-	VALUE gc_array;
 	VALUE error;
-	int i = 0;
-	int nParams;
-	char ** paramValues;
-	int *paramLengths;
-	int *paramFormats;
+	t_pg_params p;
 	int resultFormat;
 
 	rb_scan_args(argc, argv, "12", &name, &params, &in_res_fmt);
@@ -1664,7 +1978,6 @@ pgconn_send_query_prepared(int argc, VALUE *argv, VALUE self)
 
 	if(NIL_P(params)) {
 		params = rb_ary_new2(0);
-		resultFormat = 0;
 	}
 	else {
 		Check_Type(params, T_ARRAY);
@@ -1677,60 +1990,11 @@ pgconn_send_query_prepared(int argc, VALUE *argv, VALUE self)
 		resultFormat = NUM2INT(in_res_fmt);
 	}
 
-	gc_array = rb_ary_new();
-	rb_gc_register_address(&gc_array);
-	sym_value = ID2SYM(rb_intern("value"));
-	sym_format = ID2SYM(rb_intern("format"));
-	nParams = RARRAY_LEN(params);
-	paramValues = ALLOC_N(char *, nParams);
-	paramLengths = ALLOC_N(int, nParams);
-	paramFormats = ALLOC_N(int, nParams);
-	for(i = 0; i < nParams; i++) {
-		param = rb_ary_entry(params, i);
-		if (TYPE(param) == T_HASH) {
-			param_value_tmp = rb_hash_aref(param, sym_value);
-			if(param_value_tmp == Qnil)
-				param_value = param_value_tmp;
-			else
-				param_value = rb_obj_as_string(param_value_tmp);
-			param_format = rb_hash_aref(param, sym_format);
-		}
-		else {
-			if(param == Qnil)
-				param_value = param;
-			else
-				param_value = rb_obj_as_string(param);
-			param_format = INT2NUM(0);
-		}
-
-		if(param_value == Qnil) {
-			paramValues[i] = NULL;
-			paramLengths[i] = 0;
-		}
-		else {
-			Check_Type(param_value, T_STRING);
-			/* make sure param_value doesn't get freed by the GC */
-			rb_ary_push(gc_array, param_value);
-			paramValues[i] = StringValuePtr(param_value);
-			paramLengths[i] = RSTRING_LEN(param_value);
-		}
-
-		if(param_format == Qnil)
-			paramFormats[i] = 0;
-		else
-			paramFormats[i] = NUM2INT(param_format);
-	}
-	
-	result = PQsendQueryPrepared(conn, StringValuePtr(name), nParams, 
-		(const char * const *)paramValues, paramLengths, paramFormats, 
+	marshal_params(&p, params, NULL);
+	result = PQsendQueryPrepared(conn, StringValuePtr(name), p.nparams, 
+		(const char * const *)p.values, p.lengths, p.formats, 
 		resultFormat);
 
-	rb_gc_unregister_address(&gc_array);
-
-	free(paramValues);
-	free(paramLengths);
-	free(paramFormats);
-
 	if(result == 0) {
 		error = rb_exc_new2(rb_ePGError, PQerrorMessage(conn));
 		rb_iv_set(error, "@connection", self);
@@ -1804,7 +2068,7 @@ pgconn_get_result(VALUE self)
 	result = PQgetResult(conn);
 	if(result == NULL)
 		return Qnil;
-	rb_pgresult = new_pgresult(result);
+	rb_pgresult = new_pgresult(result, self);
 	if (rb_block_given_p()) {
 		return rb_ensure(yield_pgresult, rb_pgresult,
 			pgresult_clear, rb_pgresult);
@@ -2326,18 +2590,18 @@ pgconn_transaction(VALUE self)
 	
 	if (rb_block_given_p()) {
 		result = PQexec(conn, "BEGIN");
-		rb_pgresult = new_pgresult(result);
+		rb_pgresult = new_pgresult(result, self);
 		pgresult_check(self, rb_pgresult);
 		rb_protect(rb_yield, self, &status);
 		if(status == 0) {
 			result = PQexec(conn, "COMMIT");
-			rb_pgresult = new_pgresult(result);
+			rb_pgresult = new_pgresult(result, self);
 			pgresult_check(self, rb_pgresult);
 		}
 		else {
 			/* exception occurred, ROLLBACK and re-raise */
 			result = PQexec(conn, "ROLLBACK");
-			rb_pgresult = new_pgresult(result);
+			rb_pgresult = new_pgresult(result, self);
 			pgresult_check(self, rb_pgresult);
 			rb_jump_tag(status);
 		}
@@ -2489,35 +2753,338 @@ pgconn_async_exec(int argc, VALUE *argv, VALUE self)
 	return pgconn_get_last_result(self);
 }
 
-/**************************************************************************
- * LARGE OBJECT SUPPORT
- **************************************************************************/
-
 /*
- * call-seq:
- *    conn.lo_creat( [mode] ) -> Fixnum
- *
- * Creates a large object with mode _mode_. Returns a large object Oid.
- * On failure, it raises PGError exception.
+ * Yields the tuples of the query sent by pgconn_stream() as they
+ * arrive, clearing each single-tuple result right away.
  */
 static VALUE
-pgconn_locreat(int argc, VALUE *argv, VALUE self)
+pgconn_stream_tuples(VALUE self)
 {
-	Oid lo_oid;
-	int mode;
-	VALUE nmode;
 	PGconn *conn = get_pgconn(self);
+	PGresult *result;
+	VALUE rb_pgresult;
+	VALUE field_names = Qnil, first = Qnil;
+	t_pgresult *this, *first_data;
 
-	if (rb_scan_args(argc, argv, "01", &nmode) == 0)
-		mode = INV_READ;
-	else
-		mode = NUM2INT(nmode);
-
-	lo_oid = lo_creat(conn, mode);
-	if (lo_oid == 0)
-		rb_raise(rb_ePGError, "lo_creat failed");
-
-	return INT2FIX(lo_oid);
+	for(;;) {
+		pgconn_block(0, NULL, self);
+		result = PQgetResult(conn);
+		if(result == NULL)
+			break;
+		rb_pgresult = new_pgresult(result, self);
+		pgresult_check(self, rb_pgresult);
+		if(PQresultStatus(result) == PGRES_SINGLE_TUPLE) {
+			/* every tuple has the same fields, so share the hash keys
+			 * and the decoders compiled for the first one */
+			this = get_pgresult_data(rb_pgresult);
+			if(NIL_P(first)) {
+				first = rb_pgresult;
+				field_names = pgresult_field_names(rb_pgresult);
+			}
+			else {
+				this->field_names = field_names;
+				Data_Get_Struct(first, t_pgresult, first_data);
+				if(first_data->decoders != NULL && 
+						first_data->type_map == this->type_map) {
+					this->decoders = ALLOC_N(t_pg_field_decoder, first_data->ndecoders);
+					MEMCPY(this->decoders, first_data->decoders, 
+						t_pg_field_decoder, first_data->ndecoders);
+					this->ndecoders = first_data->ndecoders;
+				}
+			}
+			rb_yield(pgresult_aref(rb_pgresult, INT2FIX(0)));
+		}
+		pgresult_clear(rb_pgresult);
+	}
+	RB_GC_GUARD(first);
+	return Qnil;
+}
+
+/*
+ * Discards whatever is left of a streamed query, cancelling it
+ * first if it was abandoned before all tuples were read.
+ */
+static VALUE
+pgconn_stream_finish(VALUE self)
+{
+	PGconn *conn = get_pgconn(self);
+	PGresult *result;
+
+	if(PQtransactionStatus(conn) == PQTRANS_ACTIVE)
+		pgconn_cancel(self);
+	while((result = PQgetResult(conn)) != NULL)
+		PQclear(result);
+	return Qnil;
+}
+
+/*
+ * call-seq:
+ *    conn.stream(sql [, params, result_format ] ) { |tuple| ... } -> nil
+ *
+ * Sends SQL query request specified by _sql_ to PostgreSQL and
+ * invokes the block for each tuple, as a Hash, as soon as it is
+ * received. Unlike #exec, the complete result is never held in
+ * memory, so arbitrarily large results can be processed.
+ * _params_ and _result_format_ are as for #exec.
+ *
+ * If the block breaks out early or raises an exception, the query
+ * is cancelled and the rest of its result discarded.
+ *
+ * Requires libpq 9.2 or later (single-row mode).
+ *
+ *    conn.stream("SELECT * FROM big_table") do |tuple|
+ *      out.puts tuple['id']
+ *    end
+ */
+static VALUE
+pgconn_stream(int argc, VALUE *argv, VALUE self)
+{
+	PGconn *conn = get_pgconn(self);
+	VALUE error;
+
+	if(!rb_block_given_p()) {
+		rb_raise(rb_eArgError, "Must supply block for PGconn#stream");
+	}
+	pgconn_send_query(argc, argv, self);
+	if(PQsetSingleRowMode(conn) == 0) {
+		pgconn_stream_finish(self);
+		error = rb_exc_new2(rb_ePGError, "unable to enter single row mode");
+		rb_iv_set(error, "@connection", self);
+		rb_exc_raise(error);
+	}
+	return rb_ensure(pgconn_stream_tuples, self, pgconn_stream_finish, self);
+}
+
+/*
+ * call-seq:
+ *    conn.type_map() -> Hash
+ *
+ * Returns the registry of decoders used for the results of this
+ * connection, a Hash mapping type oids to decoders, where each 
+ * decoder is one of:
+ * * the name of a built-in type as a Symbol (see BUILTIN_TYPES), 
+ *   to decode values as the extension decodes that type
+ * * +:symbol+, to return values as Symbols, as suits enum types
+ * * +:hstore+, to decode text format hstore values to Hashes
+ * * +:symbol_array+ and +:hstore_array+, for text format arrays of
+ *   the above
+ * * +:string+, to leave values as Strings
+ * * any object responding to +call+, such as a Proc, which is 
+ *   called with the value as a String
+ * Types without an entry are returned as Strings. For example:
+ *
+ *    conn.type_map.update(PGconn::BUILTIN_TYPES)
+ *    conn.type_map[mood_oid] = :symbol
+ *    conn.type_map[money_oid] = lambda { |s| BigDecimal(s.delete('$,')) }
+ *    conn.exec("SELECT 1 AS a, 'happy'::mood AS m")[0] # {"a"=>1, "m"=>:happy}
+ *
+ * The registry is compiled into an array of decoders, one per field,
+ * when the first value of a result is decoded, so decoding a value 
+ * only costs a lookup in that array, and a call for Ruby decoders.
+ * Changes to the registry apply to results not read from yet.
+ */
+static VALUE
+pgconn_get_type_map(VALUE self)
+{
+	VALUE type_map = rb_iv_get(self, "@type_map");
+	if(NIL_P(type_map)) {
+		type_map = rb_hash_new();
+		rb_iv_set(self, "@type_map", type_map);
+	}
+	return type_map;
+}
+
+/*
+ * Raises ArgumentError unless _spec_ is a valid decoder for the type
+ * oid _key_ of a type map.
+ */
+static int
+check_type_map_entry(VALUE key, VALUE spec, VALUE arg)
+{
+	t_pg_field_decoder decoder;
+
+	if(key == Qundef)
+		return ST_CONTINUE;
+	resolve_decoder(&decoder, spec, NUM2UINT(key), 0, 1);
+	return ST_CONTINUE;
+}
+
+/*
+ * call-seq:
+ *    conn.type_map = hash
+ *
+ * Replaces the type map of the connection (see #type_map). +nil+ 
+ * removes it, so that results are returned as Strings again.
+ *
+ * Raises ArgumentError if an entry of _hash_ isn't a valid decoder,
+ * rather than leaving that to the first result decoded with it.
+ */
+static VALUE
+pgconn_set_type_map(VALUE self, VALUE type_map)
+{
+	if(!NIL_P(type_map)) {
+		Check_Type(type_map, T_HASH);
+		rb_hash_foreach(type_map, check_type_map_entry, Qnil);
+	}
+	rb_iv_set(self, "@type_map", type_map);
+	return type_map;
+}
+
+/*
+ * Builds the type map for the catalog in _result_, the rows of
+ * TYPE_CATALOG_SQL: the built-in types with decoders, enums, hstore,
+ * domains over any of these, and arrays of enums and hstore.
+ */
+#define TYPE_CATALOG_SQL \
+	"SELECT oid, typname, typtype, typelem, typbasetype " \
+	"FROM pg_catalog.pg_type"
+
+#define CATALOG_OID(result, i, col) \
+	UINT2NUM(strtoul(PQgetvalue((result), (i), (col)), NULL, 10))
+
+static VALUE
+type_catalog_map(PGresult *result)
+{
+	VALUE map = pg_builtin_types();
+	VALUE spec;
+	int ntuples = PQntuples(result);
+	int i;
+
+	for(i = 0; i < ntuples; i++) {
+		if(*PQgetvalue(result, i, 2) == 'e')
+			rb_hash_aset(map, CATALOG_OID(result, i, 0), ID2SYM(id_symbol));
+		else if(strcmp(PQgetvalue(result, i, 1), "hstore") == 0)
+			rb_hash_aset(map, CATALOG_OID(result, i, 0), ID2SYM(id_hstore));
+	}
+	/* domains, then arrays, which may be of domains */
+	for(i = 0; i < ntuples; i++) {
+		if(*PQgetvalue(result, i, 2) != 'd')
+			continue;
+		spec = rb_hash_aref(map, CATALOG_OID(result, i, 4));
+		if(!NIL_P(spec))
+			rb_hash_aset(map, CATALOG_OID(result, i, 0), spec);
+	}
+	for(i = 0; i < ntuples; i++) {
+		if(*PQgetvalue(result, i, 1) != '_')
+			continue;
+		spec = rb_hash_aref(map, CATALOG_OID(result, i, 3));
+		if(spec == ID2SYM(id_symbol))
+			rb_hash_aset(map, CATALOG_OID(result, i, 0), ID2SYM(id_symbol_array));
+		else if(spec == ID2SYM(id_hstore))
+			rb_hash_aset(map, CATALOG_OID(result, i, 0), ID2SYM(id_hstore_array));
+	}
+	return map;
+}
+
+/*
+ * Runs under type_catalog_lock: returns the catalog for the server
+ * identified by _key_, loading it through the connection if it isn't
+ * known yet or _refresh_ is true.
+ */
+static VALUE
+type_catalog_load(VALUE args)
+{
+	VALUE self = rb_ary_entry(args, 0);
+	VALUE key = rb_ary_entry(args, 1);
+	VALUE refresh = rb_ary_entry(args, 2);
+	VALUE catalog = rb_hash_aref(type_catalogs, key);
+	VALUE rb_pgresult, map;
+
+	if(!NIL_P(catalog) && !RTEST(refresh))
+		return catalog;
+
+	rb_pgresult = new_pgresult(PQexec(get_pgconn(self), TYPE_CATALOG_SQL), self);
+	pgresult_check(self, rb_pgresult);
+	map = type_catalog_map(get_pgresult(rb_pgresult));
+	pgresult_clear(rb_pgresult);
+
+	if(NIL_P(catalog)) {
+		rb_hash_aset(type_catalogs, key, map);
+		return map;
+	}
+	/* in place, so type maps already using it see the changes */
+	rb_funcall(catalog, id_replace, 1, map);
+	return catalog;
+}
+
+static VALUE
+type_catalog_unlock(VALUE lock)
+{
+	return rb_funcall(lock, id_unlock, 0);
+}
+
+/*
+ * call-seq:
+ *    conn.type_catalog( refresh = false ) -> Hash
+ *
+ * Returns a type map (see #type_map) for every type of the server
+ * the extension can decode: the built-in types, enums, +hstore+, 
+ * domains over any of these and arrays of enums and +hstore+. Use it
+ * as the connection's type map, or merge your own decoders into it:
+ *
+ *    conn.type_map = conn.type_catalog
+ *
+ * The catalog is read from +pg_type+ once per process for each
+ * server, database and server version, and shared by all 
+ * connections to it, so a pool of connections only pays for the 
+ * query once. Loading is serialized by a lock shared by all threads.
+ *
+ * Pass +true+ for _refresh_ to reload it, for instance after creating
+ * types. The shared Hash is updated in place, so connections using
+ * it directly as their type map pick up the changes; it mustn't be
+ * modified otherwise.
+ */
+static VALUE
+pgconn_type_catalog(int argc, VALUE *argv, VALUE self)
+{
+	PGconn *conn = get_pgconn(self);
+	VALUE refresh, key, args;
+	char buf[32];
+
+	rb_scan_args(argc, argv, "01", &refresh);
+	key = rb_str_new2(PQhost(conn) ? PQhost(conn) : "");
+	rb_str_cat2(key, ":");
+	rb_str_cat2(key, PQport(conn));
+	rb_str_cat2(key, "/");
+	rb_str_cat2(key, PQdb(conn));
+	snprintf(buf, sizeof(buf), "/%d", PQserverVersion(conn));
+	rb_str_cat2(key, buf);
+
+	args = rb_ary_new3(3, self, key, refresh);
+	rb_funcall(type_catalog_lock, id_lock, 0);
+	return rb_ensure(type_catalog_load, args, type_catalog_unlock, 
+		type_catalog_lock);
+}
+
+/**************************************************************************
+ * LARGE OBJECT SUPPORT
+ **************************************************************************/
+
+/*
+ * call-seq:
+ *    conn.lo_creat( [mode] ) -> Fixnum
+ *
+ * Creates a large object with mode _mode_. Returns a large object Oid.
+ * On failure, it raises PGError exception.
+ */
+static VALUE
+pgconn_locreat(int argc, VALUE *argv, VALUE self)
+{
+	Oid lo_oid;
+	int mode;
+	VALUE nmode;
+	PGconn *conn = get_pgconn(self);
+
+	if (rb_scan_args(argc, argv, "01", &nmode) == 0)
+		mode = INV_READ;
+	else
+		mode = NUM2INT(nmode);
+
+	lo_oid = lo_creat(conn, mode);
+	if (lo_oid == 0)
+		rb_raise(rb_ePGError, "lo_creat failed");
+
+	return INT2FIX(lo_oid);
 }
 
 /*
@@ -2891,11 +3458,33 @@ pgresult_result_error_field(VALUE self, VALUE field)
 static VALUE
 pgresult_clear(VALUE self)
 {
-	PQclear(get_pgresult(self));
-	DATA_PTR(self) = NULL;
+	t_pgresult *this = get_pgresult_data(self);
+	if(this->owned) {
+		PQclear(this->result);
+		adjust_result_memory_usage(-(long)this->memsize);
+	}
+	this->result = NULL;
 	return Qnil;
 }
 
+/*
+ * call-seq:
+ *    res.memsize() -> Fixnum
+ *
+ * Returns the number of bytes of memory held by the result, outside
+ * of the ruby heap. This memory is released by #clear, or when the
+ * object is garbage collected.
+ *
+ * With libpq versions before 12, the size is an estimate.
+ */
+static VALUE
+pgresult_memsize(VALUE self)
+{
+	t_pgresult *this = get_pgresult_data(self);
+	return ULONG2NUM((unsigned long)(this->owned ? 
+		this->memsize : result_memsize(this->result)));
+}
+
 /*
  * call-seq:
  *    res.ntuples() -> Fixnum
@@ -3103,21 +3692,18 @@ pgresult_fsize(VALUE self, VALUE index)
 static VALUE
 pgresult_getvalue(VALUE self, VALUE tup_num, VALUE field_num)
 {
-	PGresult *result;
+	t_pgresult *this;
 	int i = NUM2INT(tup_num);
 	int j = NUM2INT(field_num);
 
-	result = get_pgresult(self);
-	if(i < 0 || i >= PQntuples(result)) {
+	this = get_pgresult_data(self);
+	if(i < 0 || i >= PQntuples(this->result)) {
 		rb_raise(rb_eArgError,"invalid tuple number %d", i);
 	}
-	if(j < 0 || j >= PQnfields(result)) {
+	if(j < 0 || j >= PQnfields(this->result)) {
 		rb_raise(rb_eArgError,"invalid field number %d", j);
 	}
-	if(PQgetisnull(result, i, j))
-		return Qnil;
-	return rb_tainted_str_new(PQgetvalue(result, i, j), 
-				PQgetlength(result, i, j));
+	return pgresult_value(this, i, j);
 }
 
 /*
@@ -3253,6 +3839,149 @@ pgresult_oid_value(VALUE self)
 
 /* Utility methods not in libpq */
 
+/*
+ * Returns the value of field _field_num_ of tuple _tuple_num_, or
+ * +nil+ if it is +NULL+. The value is decoded if the result has a
+ * type map, and returned as a String otherwise. The caller is 
+ * responsible for range checking.
+ */
+static VALUE
+pgresult_value(t_pgresult *this, int tuple_num, int field_num)
+{
+	PGresult *result = this->result;
+	t_pg_field_decoder *decoder;
+	VALUE val;
+
+	if(PQgetisnull(result, tuple_num, field_num))
+		return Qnil;
+	if(pgresult_decoders(this) != NULL) {
+		decoder = &this->decoders[field_num];
+		if(decoder->func != NULL) {
+			val = decoder->func(PQgetvalue(result, tuple_num, field_num),
+				PQgetlength(result, tuple_num, field_num));
+			if(val != Qundef)
+				return val;
+		}
+		else if(!NIL_P(decoder->proc)) {
+			return rb_funcall(decoder->proc, id_call, 1, 
+				rb_tainted_str_new(PQgetvalue(result, tuple_num, field_num),
+					PQgetlength(result, tuple_num, field_num)));
+		}
+	}
+	return rb_tainted_str_new(PQgetvalue(result, tuple_num, field_num),
+		PQgetlength(result, tuple_num, field_num));
+}
+
+/*
+ * Returns the Array of keys used for the tuple hashes of this result:
+ * frozen Strings, or Symbols if #field_name_type is +:symbol+.
+ * The keys are built on first use and shared by every tuple.
+ */
+static VALUE
+pgresult_field_names(VALUE self)
+{
+	t_pgresult *this = get_pgresult_data(self);
+	VALUE fname;
+	int nfields, i;
+
+	if(NIL_P(this->field_names)) {
+		nfields = PQnfields(this->result);
+		this->field_names = rb_ary_new2(nfields);
+		for(i = 0; i < nfields; i++) {
+			if(SYM2ID(this->field_name_type) == id_symbol) {
+				fname = ID2SYM(rb_intern(PQfname(this->result, i)));
+			}
+			else {
+				fname = rb_tainted_str_new2(PQfname(this->result, i));
+				rb_obj_freeze(fname);
+			}
+			rb_ary_store(this->field_names, i, fname);
+		}
+		rb_obj_freeze(this->field_names);
+	}
+	return this->field_names;
+}
+
+/*
+ * Removes a trailing options Hash from _argv_, if there is one, and
+ * returns its +:fields+ entry (or +nil+).
+ */
+static VALUE
+fields_option(int *argc, VALUE *argv)
+{
+	if(*argc > 0 && TYPE(argv[*argc - 1]) == T_HASH) {
+		(*argc)--;
+		return rb_hash_aref(argv[*argc], ID2SYM(id_fields));
+	}
+	return Qnil;
+}
+
+/*
+ * Resolves the +:fields+ option of #each and #values, an Array of
+ * field names and/or numbers, into _field_nums_, which must have
+ * room for RARRAY_LEN(fields) entries.
+ */
+static void
+pgresult_field_numbers(PGresult *result, VALUE fields, int *field_nums)
+{
+	VALUE field;
+	int i, field_num;
+
+	for(i = 0; i < RARRAY_LEN(fields); i++) {
+		field = rb_ary_entry(fields, i);
+		if(FIXNUM_P(field)) {
+			field_num = FIX2INT(field);
+			if(field_num < 0 || field_num >= PQnfields(result))
+				rb_raise(rb_eArgError, "invalid field number %d", field_num);
+		}
+		else {
+			if(SYMBOL_P(field))
+				field = rb_str_new2(rb_id2name(SYM2ID(field)));
+			field_num = PQfnumber(result, StringValuePtr(field));
+			if(field_num == -1)
+				rb_raise(rb_eArgError, "Unknown field: %s", StringValuePtr(field));
+		}
+		field_nums[i] = field_num;
+	}
+}
+
+/*
+ * Looks up the field numbers of the +:fields+ option _fields_ into a
+ * String rather than on the stack, as the list comes from the caller
+ * and may be of any length. The caller keeps the String alive while
+ * it uses the numbers.
+ */
+static VALUE
+pgresult_field_numbers_buffer(PGresult *result, VALUE fields)
+{
+	VALUE buffer;
+
+	Check_Type(fields, T_ARRAY);
+	buffer = rb_str_new(NULL, RARRAY_LEN(fields) * sizeof(int));
+	pgresult_field_numbers(result, fields, (int *)RSTRING_PTR(buffer));
+	return buffer;
+}
+
+/*
+ * Returns tuple _tuple_num_ as a Hash holding the _nfields_ fields
+ * listed in _field_nums_, or all fields if _field_nums_ is NULL.
+ */
+static VALUE
+make_tuple_hash(VALUE self, int tuple_num, int *field_nums, int nfields)
+{
+	t_pgresult *this = get_pgresult_data(self);
+	VALUE fnames = pgresult_field_names(self);
+	VALUE tuple = rb_hash_new();
+	int i, field_num;
+
+	for(i = 0; i < nfields; i++) {
+		field_num = field_nums ? field_nums[i] : i;
+		rb_hash_aset(tuple, RARRAY_PTR(fnames)[field_num], 
+			pgresult_value(this, tuple_num, field_num));
+	}
+	return tuple;
+}
+
 /*
  * call-seq:
  *    res[ n ] -> Hash
@@ -3264,75 +3993,1698 @@ pgresult_aref(VALUE self, VALUE index)
 {
 	PGresult *result = get_pgresult(self);
 	int tuple_num = NUM2INT(index);
-	int field_num;
-	VALUE fname,val;
-	VALUE tuple;
 
 	if(tuple_num >= PQntuples(result))
 		rb_raise(rb_eIndexError, "Index %d is out of range", tuple_num);
-	tuple = rb_hash_new();
-	for(field_num = 0; field_num < PQnfields(result); field_num++) {
-		fname = rb_tainted_str_new2(PQfname(result,field_num));
-		if(PQgetisnull(result, tuple_num, field_num)) {
-			rb_hash_aset(tuple, fname, Qnil);
-		}
-		else {
-			val = rb_tainted_str_new(PQgetvalue(result, tuple_num, field_num),
-				PQgetlength(result, tuple_num, field_num));
-			rb_hash_aset(tuple, fname, val);
+	return make_tuple_hash(self, tuple_num, NULL, PQnfields(result));
+}
+
+/*
+ * call-seq:
+ *    res.values( [ offset [, limit ] ] [, :fields => fields ] ) -> Array
+ *
+ * Returns the tuples of the result set as an Array of Arrays,
+ * one per tuple, with the fields in the same order as #fields.
+ * +NULL+ values are returned as +nil+.
+ *
+ * The optional _offset_ and _limit_ restrict the returned tuples
+ * to at most _limit_ tuples starting with tuple number _offset_.
+ *
+ * The +:fields+ option restricts each row to the given fields,
+ * an Array of field names and/or numbers, in that order.
+ *
+ * This is much cheaper than building a Hash per tuple with #each
+ * or #[] when the whole result is needed:
+ *
+ *    res = conn.exec('SELECT 1 AS a, 2 AS b, NULL AS c')
+ *    res.values # [["1", "2", nil]]
+ *    res.values(:fields => ['c', 0]) # [[nil, "1"]]
+ */
+static VALUE
+pgresult_values(int argc, VALUE *argv, VALUE self)
+{
+	t_pgresult *this = get_pgresult_data(self);
+	PGresult *result = this->result;
+	VALUE in_offset, in_limit, fields;
+	VALUE rows, row, buffer = Qnil;
+	int ntuples = PQntuples(result);
+	int nfields = PQnfields(result);
+	int *field_nums = NULL;
+	int offset = 0;
+	int limit;
+	int tuple_num, i;
+
+	fields = fields_option(&argc, argv);
+	rb_scan_args(argc, argv, "02", &in_offset, &in_limit);
+
+	if(!NIL_P(in_offset))
+		offset = NUM2INT(in_offset);
+	if(offset < 0 || offset > ntuples)
+		rb_raise(rb_eIndexError, "Index %d is out of range", offset);
+
+	limit = ntuples - offset;
+	if(!NIL_P(in_limit)) {
+		if(NUM2INT(in_limit) < 0)
+			rb_raise(rb_eArgError, "negative limit: %d", NUM2INT(in_limit));
+		if(NUM2INT(in_limit) < limit)
+			limit = NUM2INT(in_limit);
+	}
+
+	if(!NIL_P(fields)) {
+		buffer = pgresult_field_numbers_buffer(result, fields);
+		nfields = RARRAY_LEN(fields);
+		field_nums = (int *)RSTRING_PTR(buffer);
+	}
+
+	rows = rb_ary_new2(limit);
+	for(tuple_num = offset; tuple_num < offset + limit; tuple_num++) {
+		row = rb_ary_new2(nfields);
+		for(i = 0; i < nfields; i++) {
+			rb_ary_store(row, i, pgresult_value(this, tuple_num, 
+				field_nums ? field_nums[i] : i));
 		}
+		rb_ary_store(rows, tuple_num - offset, row);
 	}
-	return tuple;
+	RB_GC_GUARD(buffer);
+	return rows;
 }
 
 /*
  * call-seq:
  *    res.each{ |tuple| ... }
+ *    res.each( :fields => fields ){ |tuple| ... }
  *
  * Invokes block for each tuple in the result set.
+ *
+ * With the +:fields+ option, an Array of field names and/or numbers,
+ * each tuple Hash only holds those fields, and no other values are
+ * read from the result:
+ *
+ *    res = conn.exec('SELECT * FROM wide_table')
+ *    res.each(:fields => ['id', 'name']) { |tuple| ... }
  */
 static VALUE
-pgresult_each(VALUE self)
+pgresult_each(int argc, VALUE *argv, VALUE self)
 {
 	PGresult *result = get_pgresult(self);
+	VALUE fields, buffer = Qnil;
+	int *field_nums = NULL;
+	int nfields = PQnfields(result);
 	int tuple_num;
 
-	for(tuple_num = 0; tuple_num < PQntuples(result); tuple_num++) {
-		rb_yield(pgresult_aref(self, INT2NUM(tuple_num)));
+	fields = fields_option(&argc, argv);
+	if(argc > 0)
+		rb_raise(rb_eArgError, "wrong number of arguments (%d for 0)", argc);
+	if(!NIL_P(fields)) {
+		buffer = pgresult_field_numbers_buffer(result, fields);
+		nfields = RARRAY_LEN(fields);
+		field_nums = (int *)RSTRING_PTR(buffer);
 	}
+
+	for(tuple_num = 0; tuple_num < PQntuples(get_pgresult(self)); tuple_num++) {
+		rb_yield(make_tuple_hash(self, tuple_num, field_nums, nfields));
+	}
+	RB_GC_GUARD(buffer);
 	return self;
 }
 
 /*
- * call-seq:
- *    res.fields() -> Array
- *
- * Returns an array of Strings representing the names of the fields in the result.
+ * Builds the Hash of #index_by_field, or of #group_by_field if _group_
+ * is set.
  */
 static VALUE
-pgresult_fields(VALUE self)
+pgresult_index(int argc, VALUE *argv, VALUE self, int group)
 {
-	PGresult *result;
-	VALUE ary;
-	int n, i;
+	t_pgresult *this = get_pgresult_data(self);
+	PGresult *result = this->result;
+	VALUE column, options, fields, key, tuple, list, buffer = Qnil;
+	VALUE index = rb_hash_new();
+	t_pg_decoder key_decoder = NULL;
+	int *field_nums = NULL;
+	int nfields = PQnfields(result);
+	int ntuples = PQntuples(result);
+	int key_field, tuple_num;
+
+	rb_scan_args(argc, argv, "11", &column, &options);
+	pgresult_field_numbers(result, rb_ary_new3(1, column), &key_field);
+	fields = Qnil;
+	if(!NIL_P(options)) {
+		Check_Type(options, T_HASH);
+		fields = rb_hash_aref(options, ID2SYM(id_fields));
+		if(pgresult_decoders(this) == NULL && RTEST(rb_hash_aref(options, ID2SYM(id_typed)))) {
+			key_decoder = PQfformat(result, key_field) == 0 ? 
+				pg_text_decoder(PQftype(result, key_field)) :
+				pg_bin_decoder(PQftype(result, key_field), 
+					pgresult_integer_datetimes(this));
+		}
+	}
+	if(!NIL_P(fields)) {
+		buffer = pgresult_field_numbers_buffer(result, fields);
+		nfields = RARRAY_LEN(fields);
+		field_nums = (int *)RSTRING_PTR(buffer);
+	}
 
-	result = get_pgresult(self);
-	n = PQnfields(result);
-	ary = rb_ary_new2(n);
-	for (i=0;i<n;i++) {
-		rb_ary_push(ary, rb_tainted_str_new2(PQfname(result, i)));
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		key = Qundef;
+		if(key_decoder != NULL && !PQgetisnull(result, tuple_num, key_field)) {
+			key = key_decoder(PQgetvalue(result, tuple_num, key_field),
+				PQgetlength(result, tuple_num, key_field));
+		}
+		if(key == Qundef)
+			key = pgresult_value(this, tuple_num, key_field);
+		/* a frozen String key is used as is instead of being copied */
+		if(TYPE(key) == T_STRING)
+			rb_obj_freeze(key);
+
+		tuple = make_tuple_hash(self, tuple_num, field_nums, nfields);
+		if(!group) {
+			rb_hash_aset(index, key, tuple);
+			continue;
+		}
+		list = rb_hash_aref(index, key);
+		if(NIL_P(list)) {
+			list = rb_ary_new();
+			rb_hash_aset(index, key, list);
+		}
+		rb_ary_push(list, tuple);
 	}
-	return ary;
+	RB_GC_GUARD(buffer);
+	return index;
 }
 
-/**************************************************************************/
+/*
+ * call-seq:
+ *    res.index_by_field( field [, options ] ) -> Hash
+ *
+ * Returns a Hash mapping the value of _field_ (a field name or 
+ * number) in each tuple to the tuple, as a Hash like those of #each.
+ * When several tuples have the same value, the last one wins. This
+ * is a single pass over the result, without a Ruby block call or 
+ * an intermediate tuple Hash per key lookup:
+ *
+ *    res = conn.exec("SELECT id, name FROM users")
+ *    users = res.index_by_field('id')
+ *    users['42'] # {"id"=>"42", "name"=>"..."}
+ *
+ * _options_ is a Hash of:
+ * [+:fields+] restricts the tuples to the given fields, as for #each
+ * [+:typed+]  if +true+, decodes the keys as the +:builtin+ type map
+ *             would (see #type_map=) even if the result has no type
+ *             map, e.g. to Integers for an +int4+ field. With a type
+ *             map, keys are always decoded by it.
+ */
+static VALUE
+pgresult_index_by_field(int argc, VALUE *argv, VALUE self)
+{
+	return pgresult_index(argc, argv, self, 0);
+}
 
-void
-Init_pg()
+/*
+ * call-seq:
+ *    res.group_by_field( field [, options ] ) -> Hash
+ *
+ * Like #index_by_field, but maps each value of _field_ to an Array of all 
+ * the tuples with that value, in the order of the result.
+ */
+static VALUE
+pgresult_group_by_field(int argc, VALUE *argv, VALUE self)
 {
-	rb_ePGError = rb_define_class("PGError", rb_eStandardError);
-	rb_cPGconn = rb_define_class("PGconn", rb_cObject);
-	rb_cPGresult = rb_define_class("PGresult", rb_cObject);
+	return pgresult_index(argc, argv, self, 1);
+}
+
+/*
+ * call-seq:
+ *    res.each_row{ |row| ... }
+ *
+ * Invokes block for each tuple in the result set, passing a PGrow.
+ * Unlike #each, no values are read from the result until they are
+ * asked for, which is cheaper when only a few fields of each tuple
+ * are needed.
+ */
+static VALUE
+pgresult_each_row(VALUE self)
+{
+	t_pgrow *row;
+	VALUE rb_pgrow;
+	int tuple_num;
+
+	for(tuple_num = 0; tuple_num < PQntuples(get_pgresult(self)); tuple_num++) {
+		rb_pgrow = Data_Make_Struct(rb_cPGrow, t_pgrow, mark_pgrow, 
+			free_pgrow, row);
+		row->result = self;
+		row->tuple_num = tuple_num;
+		rb_yield(rb_pgrow);
+	}
+	return self;
+}
+
+/*
+ * call-seq:
+ *    res.each_row_reuse{ |values| ... }
+ *
+ * Invokes block for each tuple in the result set, passing its values
+ * as an Array in field order, like the rows of #values.
+ *
+ * The same Array is refilled for every tuple, so only the values
+ * themselves are allocated. The block must not keep a reference
+ * to the Array; use <tt>values.dup</tt> to hold on to a tuple.
+ *
+ *    total = 0
+ *    res.each_row_reuse { |id, amount| total += amount.to_i }
+ */
+static VALUE
+pgresult_each_row_reuse(VALUE self)
+{
+	t_pgresult *this;
+	int nfields = PQnfields(get_pgresult(self));
+	int tuple_num, field_num;
+	VALUE values = rb_ary_new2(nfields);
+
+	for(tuple_num = 0; tuple_num < PQntuples(get_pgresult(self)); tuple_num++) {
+		this = get_pgresult_data(self);
+		for(field_num = 0; field_num < nfields; field_num++) {
+			rb_ary_store(values, field_num, 
+				pgresult_value(this, tuple_num, field_num));
+		}
+		rb_yield(values);
+	}
+	return self;
+}
+
+/*
+ * Returns all values of field _field_num_ as an Array.
+ */
+static VALUE
+make_column_result_array(t_pgresult *this, int field_num)
+{
+	int ntuples = PQntuples(this->result);
+	int tuple_num;
+	VALUE ary = rb_ary_new2(ntuples);
+
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		rb_ary_store(ary, tuple_num, 
+			pgresult_value(this, tuple_num, field_num));
+	}
+	return ary;
+}
+
+/*
+ * call-seq:
+ *    res.column_values( n ) -> Array
+ *
+ * Returns an Array of the values from the nth column of each tuple
+ * in the result, with +NULL+ values as +nil+.
+ *
+ * Raises ArgumentError if _n_ is out of range.
+ */
+static VALUE
+pgresult_column_values(VALUE self, VALUE index)
+{
+	t_pgresult *this = get_pgresult_data(self);
+	int field_num = NUM2INT(index);
+
+	if(field_num < 0 || field_num >= PQnfields(this->result)) {
+		rb_raise(rb_eArgError, "invalid field number %d", field_num);
+	}
+	return make_column_result_array(this, field_num);
+}
+
+/*
+ * call-seq:
+ *    res.field_values( field ) -> Array
+ *
+ * Returns an Array of the values from the given _field_ of each tuple
+ * in the result, with +NULL+ values as +nil+.
+ *
+ * Raises ArgumentError if _field_ isn't one of the field names;
+ * raises a TypeError if _field_ is not a String.
+ */
+static VALUE
+pgresult_field_values(VALUE self, VALUE field)
+{
+	t_pgresult *this = get_pgresult_data(self);
+	int field_num;
+
+	Check_Type(field, T_STRING);
+	field_num = PQfnumber(this->result, StringValuePtr(field));
+	if(field_num == -1) {
+		rb_raise(rb_eArgError, "Unknown field: %s", StringValuePtr(field));
+	}
+	return make_column_result_array(this, field_num);
+}
+
+/*
+ * call-seq:
+ *    res.array_values( n ) -> Array
+ *
+ * Returns an Array of the values from the nth column of each tuple,
+ * parsed from PostgreSQL array literals such as 
+ * <tt>{1,2,"a b",NULL}</tt> into (nested) Arrays. Elements of 
+ * built-in array types are decoded as with the +:builtin+ type map
+ * (see #type_map=); others are returned as Strings. +NULL+ values
+ * and elements are returned as +nil+.
+ *
+ * This works regardless of the column's type and of #type_map, so
+ * it also applies to arrays of types the extension doesn't know.
+ *
+ * Raises ArgumentError if _n_ is out of range, or if a value isn't
+ * a well-formed text format array.
+ */
+static VALUE
+pgresult_array_values(VALUE self, VALUE index)
+{
+	PGresult *result = get_pgresult(self);
+	int field_num = NUM2INT(index);
+	int ntuples = PQntuples(result);
+	int tuple_num;
+	t_pg_decoder decoder;
+	VALUE ary, val;
+
+	if(field_num < 0 || field_num >= PQnfields(result)) {
+		rb_raise(rb_eArgError, "invalid field number %d", field_num);
+	}
+	if(PQfformat(result, field_num) != 0) {
+		rb_raise(rb_eArgError, "field %d is not in text format", field_num);
+	}
+	decoder = pg_text_array_decoder(PQftype(result, field_num));
+	ary = rb_ary_new2(ntuples);
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		if(PQgetisnull(result, tuple_num, field_num)) {
+			val = Qnil;
+		}
+		else {
+			val = decoder(PQgetvalue(result, tuple_num, field_num),
+				PQgetlength(result, tuple_num, field_num));
+			if(val == Qundef)
+				rb_raise(rb_eArgError, "malformed array literal in tuple %d", 
+					tuple_num);
+		}
+		rb_ary_store(ary, tuple_num, val);
+	}
+	return ary;
+}
+
+/*
+ * Output buffer of #write_csv, written to the IO whenever it fills.
+ * _buf_ points into the String _str_, which is passed to the IO as is
+ * rather than copied for every write.
+ */
+#define CSV_BUFSIZE (64 * 1024)
+
+typedef struct {
+	VALUE io;
+	VALUE str;
+	char *buf;
+	long len;
+} t_csv_writer;
+
+static void
+csv_flush(t_csv_writer *w)
+{
+	if(w->len > 0) {
+		rb_str_set_len(w->str, w->len);
+		rb_io_write(w->io, w->str);
+		/* the IO may have resized or modified it */
+		rb_str_resize(w->str, CSV_BUFSIZE);
+		w->buf = RSTRING_PTR(w->str);
+		w->len = 0;
+	}
+}
+
+static void
+csv_put(t_csv_writer *w, const char *p, long n)
+{
+	long chunk;
+
+	while(n > 0) {
+		chunk = CSV_BUFSIZE - w->len;
+		if(chunk > n)
+			chunk = n;
+		memcpy(w->buf + w->len, p, chunk);
+		w->len += chunk;
+		p += chunk;
+		n -= chunk;
+		if(w->len == CSV_BUFSIZE)
+			csv_flush(w);
+	}
+}
+
+/*
+ * Writes the field _p_, quoting it if it contains the delimiter,
+ * the quote character or a line break, or if _force_ is set.
+ */
+static void
+csv_put_field(t_csv_writer *w, const char *p, long n, char delim, char quote,
+	int force)
+{
+	const char *end = p + n, *run;
+	int needs_quotes = force;
+
+	for(run = p; !needs_quotes && run < end; run++) {
+		if(*run == delim || *run == quote || *run == '\n' || *run == '\r')
+			needs_quotes = 1;
+	}
+	if(!needs_quotes) {
+		csv_put(w, p, n);
+		return;
+	}
+
+	csv_put(w, &quote, 1);
+	for(run = p; p < end; p++) {
+		if(*p == quote) {
+			/* double it: the run up to and including it, then again */
+			csv_put(w, run, p - run + 1);
+			run = p;
+		}
+	}
+	csv_put(w, run, p - run);
+	csv_put(w, &quote, 1);
+}
+
+static char
+csv_char_option(VALUE options, ID id, char def)
+{
+	VALUE val = rb_hash_aref(options, ID2SYM(id));
+	if(NIL_P(val))
+		return def;
+	StringValue(val);
+	if(RSTRING_LEN(val) != 1)
+		rb_raise(rb_eArgError, ":%s must be a single character", rb_id2name(id));
+	return RSTRING_PTR(val)[0];
+}
+
+/*
+ * call-seq:
+ *    res.write_csv( io [, options ] ) -> nil
+ *
+ * Writes the result to _io_ as CSV, formatting the values straight
+ * from the libpq buffers into a large buffer that is written to _io_
+ * each time it fills up, so no Ruby objects are built per value or
+ * per row. _io_ may be anything with a +write+ method. The same
+ * String is passed to every call of +write+ and then reused, so an
+ * _io_ that keeps it must keep a copy.
+ *
+ * The output is that of <tt>COPY ... TO ... CSV</tt> with the same
+ * options. _options_ is a Hash of:
+ * [+:delimiter+] the field separator, <tt>","</tt> by default; use
+ *                <tt>"\t"</tt> for TSV
+ * [+:quote+]     the quote character, <tt>'"'</tt> by default. It is
+ *                doubled inside quoted values.
+ * [+:header+]    if +true+, a first line with the field names
+ * [+:null+]      the String written for +NULL+ values, empty by
+ *                default. Values equal to it are quoted so they can
+ *                be told apart.
+ *
+ * Values are quoted only when needed. Every field must be in text
+ * format.
+ */
+static VALUE
+pgresult_write_csv(int argc, VALUE *argv, VALUE self)
+{
+	PGresult *result = get_pgresult(self);
+	VALUE io, options, null_str, scratch;
+	t_csv_writer w;
+	char delim, quote;
+	const char *null_ptr = "", *value;
+	long null_len = 0;
+	int nfields = PQnfields(result);
+	int ntuples = PQntuples(result);
+	int tuple_num, field_num, length;
+
+	rb_scan_args(argc, argv, "11", &io, &options);
+	if(NIL_P(options))
+		options = rb_hash_new();
+	Check_Type(options, T_HASH);
+	delim = csv_char_option(options, id_delimiter, ',');
+	quote = csv_char_option(options, id_quote, '"');
+	null_str = rb_hash_aref(options, ID2SYM(id_null));
+	if(!NIL_P(null_str)) {
+		StringValue(null_str);
+		null_ptr = RSTRING_PTR(null_str);
+		null_len = RSTRING_LEN(null_str);
+	}
+	for(field_num = 0; field_num < nfields; field_num++) {
+		if(PQfformat(result, field_num) != 0)
+			rb_raise(rb_eArgError, "field %d is not in text format", field_num);
+	}
+
+	scratch = rb_str_new(NULL, CSV_BUFSIZE);
+	w.io = io;
+	w.str = scratch;
+	w.buf = RSTRING_PTR(scratch);
+	w.len = 0;
+
+	if(RTEST(rb_hash_aref(options, ID2SYM(id_header)))) {
+		for(field_num = 0; field_num < nfields; field_num++) {
+			if(field_num > 0)
+				csv_put(&w, &delim, 1);
+			value = PQfname(result, field_num);
+			csv_put_field(&w, value, strlen(value), delim, quote, 0);
+		}
+		csv_put(&w, "\n", 1);
+	}
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		for(field_num = 0; field_num < nfields; field_num++) {
+			if(field_num > 0)
+				csv_put(&w, &delim, 1);
+			if(PQgetisnull(result, tuple_num, field_num)) {
+				csv_put(&w, null_ptr, null_len);
+				continue;
+			}
+			value = PQgetvalue(result, tuple_num, field_num);
+			length = PQgetlength(result, tuple_num, field_num);
+			csv_put_field(&w, value, length, delim, quote,
+				length == null_len && memcmp(value, null_ptr, length) == 0);
+		}
+		csv_put(&w, "\n", 1);
+	}
+	csv_flush(&w);
+	/* both are only used through pointers across rb_io_write() */
+	RB_GC_GUARD(scratch);
+	RB_GC_GUARD(null_str);
+	return Qnil;
+}
+
+/*
+ * PGresult#dump format, all integers in network byte order:
+ *   "PGR1", nfields (4), ntuples (4)
+ *   per field: name length (4), name, type oid (4), table oid (4),
+ *              column number (2), format (2), type length (2),
+ *              type modifier (4)
+ *   NULL bitmap, one bit per value in row-major order
+ *   per non-NULL value in row-major order: its length as a varint
+ *   (7 bits per byte, least significant first), then its bytes
+ */
+#define DUMP_MAGIC "PGR1"
+#define DUMP_FIELD_SIZE (4 + 4 + 4 + 2 + 2 + 2 + 4)
+/* no result from the server has more fields (MaxTupleAttributeNumber) */
+#define DUMP_MAX_FIELDS 1664
+
+static char *
+dump_uint32(char *p, unsigned int val)
+{
+	p[0] = (char)(val >> 24);
+	p[1] = (char)(val >> 16);
+	p[2] = (char)(val >> 8);
+	p[3] = (char)val;
+	return p + 4;
+}
+
+static char *
+dump_uint16(char *p, unsigned int val)
+{
+	p[0] = (char)(val >> 8);
+	p[1] = (char)val;
+	return p + 2;
+}
+
+static char *
+dump_varint(char *p, unsigned int val)
+{
+	while(val >= 0x80) {
+		*p++ = (char)(val | 0x80);
+		val >>= 7;
+	}
+	*p++ = (char)val;
+	return p;
+}
+
+static int
+varint_size(unsigned int val)
+{
+	int n = 1;
+	while(val >= 0x80) {
+		val >>= 7;
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Reads a varint at *_pp_, advancing it. Returns 0 if it runs past
+ * _end_ or doesn't fit in an int.
+ */
+static int
+load_varint(const char **pp, const char *end, unsigned int *out)
+{
+	const char *p = *pp;
+	unsigned int val = 0;
+	int shift;
+
+	for(shift = 0; p < end && shift < 32; shift += 7) {
+		val |= (unsigned int)(*p & 0x7F) << shift;
+		if(!(*p++ & 0x80)) {
+			if(val > 0x7FFFFFFF)
+				return 0;
+			*pp = p;
+			*out = val;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static unsigned int
+load_uint32(const char *p)
+{
+	const unsigned char *u = (const unsigned char *)p;
+	return (unsigned int)u[0] << 24 | (unsigned int)u[1] << 16 | 
+		(unsigned int)u[2] << 8 | u[3];
+}
+
+static unsigned int
+load_uint16(const char *p)
+{
+	const unsigned char *u = (const unsigned char *)p;
+	return (unsigned int)u[0] << 8 | u[1];
+}
+
+/*
+ * call-seq:
+ *    res.dump() -> String
+ *
+ * Serializes the field descriptions and values of the result into a
+ * compact binary String, for caching. PGresult.load turns it back
+ * into a PGresult. Only the tuples are kept, not the status or the
+ * command tag.
+ */
+static VALUE
+pgresult_dump(VALUE self)
+{
+	PGresult *result = get_pgresult(self);
+	int nfields = PQnfields(result);
+	int ntuples = PQntuples(result);
+	long nvalues = (long)nfields * ntuples;
+	long size, bitmap_size, i;
+	int tuple_num, field_num, length;
+	char *p, *bitmap;
+	VALUE blob;
+
+	size = 12;
+	for(field_num = 0; field_num < nfields; field_num++)
+		size += DUMP_FIELD_SIZE + strlen(PQfname(result, field_num));
+	bitmap_size = (nvalues + 7) / 8;
+	size += bitmap_size;
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		for(field_num = 0; field_num < nfields; field_num++) {
+			if(PQgetisnull(result, tuple_num, field_num))
+				continue;
+			length = PQgetlength(result, tuple_num, field_num);
+			size += varint_size(length) + length;
+		}
+	}
+
+	blob = rb_str_new(NULL, size);
+	p = RSTRING_PTR(blob);
+	memcpy(p, DUMP_MAGIC, 4);
+	p = dump_uint32(p + 4, nfields);
+	p = dump_uint32(p, ntuples);
+	for(field_num = 0; field_num < nfields; field_num++) {
+		length = (int)strlen(PQfname(result, field_num));
+		p = dump_uint32(p, length);
+		memcpy(p, PQfname(result, field_num), length);
+		p = dump_uint32(p + length, PQftype(result, field_num));
+		p = dump_uint32(p, PQftable(result, field_num));
+		p = dump_uint16(p, PQftablecol(result, field_num));
+		p = dump_uint16(p, PQfformat(result, field_num));
+		p = dump_uint16(p, PQfsize(result, field_num));
+		p = dump_uint32(p, PQfmod(result, field_num));
+	}
+
+	bitmap = p;
+	memset(bitmap, 0, bitmap_size);
+	p += bitmap_size;
+	for(i = 0, tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		for(field_num = 0; field_num < nfields; field_num++, i++) {
+			if(PQgetisnull(result, tuple_num, field_num)) {
+				bitmap[i / 8] |= 1 << (i % 8);
+				continue;
+			}
+			length = PQgetlength(result, tuple_num, field_num);
+			p = dump_varint(p, length);
+			memcpy(p, PQgetvalue(result, tuple_num, field_num), length);
+			p += length;
+		}
+	}
+	OBJ_INFECT(blob, self);
+	return blob;
+}
+
+static void
+invalid_dump(void)
+{
+	rb_raise(rb_eArgError, "invalid PGresult dump");
+}
+
+/*
+ * call-seq:
+ *    PGresult.load( string ) -> PGresult
+ *
+ * Rebuilds a result from the output of PGresult#dump. The values
+ * are copied from _string_ into the new result without creating
+ * Ruby objects for them, and it supports the same methods as the
+ * results of a query, except that it has no connection.
+ */
+static VALUE
+pgresult_s_load(VALUE klass, VALUE blob)
+{
+	const char *p, *q, *end, *bitmap;
+	PGresAttDesc *attrs;
+	PGresult *result;
+	VALUE buffer;
+	long nvalues, names_size, i;
+	unsigned int nfields, ntuples, length;
+	int tuple_num, field_num, ok;
+	char *names;
+
+	StringValue(blob);
+	p = RSTRING_PTR(blob);
+	end = p + RSTRING_LEN(blob);
+	if(end - p < 12 || memcmp(p, DUMP_MAGIC, 4) != 0)
+		invalid_dump();
+	nfields = load_uint32(p + 4);
+	ntuples = load_uint32(p + 8);
+	p += 12;
+	if(nfields > DUMP_MAX_FIELDS || 
+			nfields > (size_t)(end - p) / DUMP_FIELD_SIZE || 
+			(nfields == 0 && ntuples > 0) ||
+			(nfields > 0 && ntuples / 8 > (size_t)(end - p) / nfields))
+		invalid_dump();
+
+	/* the field descriptors are checked before anything is allocated
+	 * for them, which is then sized by the dump itself */
+	names_size = 0;
+	for(q = p, field_num = 0; field_num < (int)nfields; field_num++) {
+		if(end - q < 4 || (length = load_uint32(q)) > (size_t)(end - q) - 4 ||
+				end - q - 4 - length < DUMP_FIELD_SIZE - 4)
+			invalid_dump();
+		names_size += length + 1;
+		q += DUMP_FIELD_SIZE + length;
+	}
+	buffer = rb_str_new(NULL, nfields * sizeof(PGresAttDesc) + names_size);
+	attrs = (PGresAttDesc *)RSTRING_PTR(buffer);
+	names = (char *)(attrs + nfields);
+	for(field_num = 0; field_num < (int)nfields; field_num++) {
+		/* PQsetResultAttrs copies the names */
+		length = load_uint32(p);
+		memcpy(names, p + 4, length);
+		names[length] = '\0';
+		p += 4 + length;
+		attrs[field_num].name = names;
+		names += length + 1;
+		attrs[field_num].typid = load_uint32(p);
+		attrs[field_num].tableid = load_uint32(p + 4);
+		attrs[field_num].columnid = (short)load_uint16(p + 8);
+		attrs[field_num].format = (short)load_uint16(p + 10);
+		attrs[field_num].typlen = (short)load_uint16(p + 12);
+		attrs[field_num].atttypmod = (int)load_uint32(p + 14);
+		p += DUMP_FIELD_SIZE - 4;
+	}
+
+	nvalues = (long)nfields * ntuples;
+	bitmap = p;
+	p += (nvalues + 7) / 8;
+	if(p > end)
+		invalid_dump();
+
+	result = PQmakeEmptyPGresult(NULL, PGRES_TUPLES_OK);
+	if(result == NULL)
+		rb_raise(rb_eNoMemError, "out of memory");
+	if(nfields > 0 && !PQsetResultAttrs(result, nfields, attrs)) {
+		PQclear(result);
+		rb_raise(rb_eNoMemError, "out of memory");
+	}
+	RB_GC_GUARD(buffer);
+	ok = 1;
+	for(i = 0, tuple_num = 0; ok && tuple_num < (int)ntuples; tuple_num++) {
+		for(field_num = 0; ok && field_num < (int)nfields; field_num++, i++) {
+			if(bitmap[i / 8] & (1 << (i % 8))) {
+				ok = PQsetvalue(result, tuple_num, field_num, NULL, -1);
+			}
+			else if((ok = load_varint(&p, end, &length) && 
+					length <= (size_t)(end - p))) {
+				ok = PQsetvalue(result, tuple_num, field_num, (char *)p, length);
+				p += length;
+			}
+		}
+	}
+	if(!ok || p != end) {
+		PQclear(result);
+		invalid_dump();
+	}
+	return new_pgresult(result, Qnil);
+}
+
+/*
+ * Returns the attribute names of the composite type _type_ as a
+ * frozen Array of frozen Strings, or +nil+ if _type_ isn't a named
+ * composite type (e.g. an anonymous +record+). The names are read
+ * from the catalog with a query on _rb_pgconn_ the first time a type
+ * is seen, and kept for the lifetime of the connection.
+ */
+static VALUE
+pgconn_composite_attributes(VALUE rb_pgconn, Oid type)
+{
+	VALUE cache = rb_iv_get(rb_pgconn, "@composite_attributes");
+	VALUE key = UINT2NUM(type);
+	VALUE names, rb_pgresult, fname;
+	PGresult *result;
+	char oid_str[16];
+	const char *params[1];
+	int ntuples, i;
+
+	if(NIL_P(cache)) {
+		cache = rb_hash_new();
+		rb_iv_set(rb_pgconn, "@composite_attributes", cache);
+	}
+	else if(!NIL_P(names = rb_hash_aref(cache, key))) {
+		/* false marks a type known not to be a composite */
+		return RTEST(names) ? names : Qnil;
+	}
+
+	snprintf(oid_str, sizeof(oid_str), "%u", type);
+	params[0] = oid_str;
+	result = PQexecParams(get_pgconn(rb_pgconn),
+		"SELECT a.attname FROM pg_catalog.pg_type t "
+		"JOIN pg_catalog.pg_attribute a ON a.attrelid = t.typrelid "
+		"WHERE t.oid = $1 AND a.attnum > 0 AND NOT a.attisdropped "
+		"ORDER BY a.attnum",
+		1, NULL, params, NULL, NULL, 0);
+	rb_pgresult = new_pgresult(result, rb_pgconn);
+	pgresult_check(rb_pgconn, rb_pgresult);
+
+	ntuples = PQntuples(result);
+	names = Qnil;
+	if(ntuples > 0) {
+		names = rb_ary_new2(ntuples);
+		for(i = 0; i < ntuples; i++) {
+			fname = rb_tainted_str_new2(PQgetvalue(result, i, 0));
+			rb_obj_freeze(fname);
+			rb_ary_store(names, i, fname);
+		}
+		rb_obj_freeze(names);
+	}
+	pgresult_clear(rb_pgresult);
+	rb_hash_aset(cache, key, NIL_P(names) ? Qfalse : names);
+	return names;
+}
+
+/*
+ * call-seq:
+ *    res.record_values( n ) -> Array
+ *
+ * Returns an Array of the values from the nth column of each tuple,
+ * parsed from the text output of a composite type or +ROW()+ 
+ * expression, such as <tt>(1,"foo bar",,t)</tt>, into Arrays of
+ * Strings. Empty attributes are +NULL+ and returned as +nil+.
+ *
+ * Raises ArgumentError if _n_ is out of range, or if a value isn't
+ * a well-formed text format record.
+ */
+static VALUE
+pgresult_record_values(VALUE self, VALUE index)
+{
+	PGresult *result = get_pgresult(self);
+	int field_num = NUM2INT(index);
+	int ntuples = PQntuples(result);
+	int tuple_num;
+	VALUE ary, val;
+
+	if(field_num < 0 || field_num >= PQnfields(result)) {
+		rb_raise(rb_eArgError, "invalid field number %d", field_num);
+	}
+	if(PQfformat(result, field_num) != 0) {
+		rb_raise(rb_eArgError, "field %d is not in text format", field_num);
+	}
+	ary = rb_ary_new2(ntuples);
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		if(PQgetisnull(result, tuple_num, field_num)) {
+			val = Qnil;
+		}
+		else {
+			val = pg_text_dec_record(PQgetvalue(result, tuple_num, field_num),
+				PQgetlength(result, tuple_num, field_num));
+			if(val == Qundef)
+				rb_raise(rb_eArgError, "malformed record literal in tuple %d", 
+					tuple_num);
+		}
+		rb_ary_store(ary, tuple_num, val);
+	}
+	return ary;
+}
+
+/*
+ * call-seq:
+ *    res.hstore_values( n ) -> Array
+ *
+ * Returns an Array of the values from the nth column of each tuple,
+ * parsed from the text representation of an +hstore+, such as
+ * <tt>"k"=>"v", "k2"=>NULL</tt>, into Hashes of Strings. +NULL+ 
+ * values in the hstore are returned as +nil+.
+ *
+ * +hstore+ is an extension type without a fixed oid, so it isn't
+ * decoded by the +:builtin+ type map; use this instead.
+ *
+ * Raises ArgumentError if _n_ is out of range, or if a value isn't
+ * a well-formed hstore.
+ */
+static VALUE
+pgresult_hstore_values(VALUE self, VALUE index)
+{
+	PGresult *result = get_pgresult(self);
+	int field_num = NUM2INT(index);
+	int ntuples = PQntuples(result);
+	int tuple_num;
+	VALUE ary, val;
+
+	if(field_num < 0 || field_num >= PQnfields(result)) {
+		rb_raise(rb_eArgError, "invalid field number %d", field_num);
+	}
+	if(PQfformat(result, field_num) != 0) {
+		rb_raise(rb_eArgError, "field %d is not in text format", field_num);
+	}
+	ary = rb_ary_new2(ntuples);
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		if(PQgetisnull(result, tuple_num, field_num)) {
+			val = Qnil;
+		}
+		else {
+			val = pg_text_dec_hstore(PQgetvalue(result, tuple_num, field_num),
+				PQgetlength(result, tuple_num, field_num));
+			if(val == Qundef)
+				rb_raise(rb_eArgError, "malformed hstore literal in tuple %d", 
+					tuple_num);
+		}
+		rb_ary_store(ary, tuple_num, val);
+	}
+	return ary;
+}
+
+/*
+ * call-seq:
+ *    res.record_hashes( n ) -> Array
+ *
+ * Like #record_values, but returns each record as a Hash keyed by
+ * the attribute names of the column's composite type. The keys are
+ * Strings, or Symbols if #field_name_type is +:symbol+.
+ *
+ * The attribute names are looked up in the catalog the first time
+ * a composite type is seen on the result's connection, and cached 
+ * there for later results. The lookup runs a query, so it mustn't 
+ * be used while the connection is busy with another one.
+ *
+ * Raises ArgumentError if the column isn't of a named composite type.
+ */
+static VALUE
+pgresult_record_hashes(VALUE self, VALUE index)
+{
+	t_pgresult *this = get_pgresult_data(self);
+	VALUE ary, names, keys, val, hash;
+	long i, nkeys;
+	int field_num, ntuples, tuple_num;
+
+	ary = pgresult_record_values(self, index);
+	field_num = NUM2INT(index);
+	ntuples = PQntuples(this->result);
+
+	if(NIL_P(this->connection)) {
+		rb_raise(rb_ePGError, "result has no connection");
+	}
+	names = pgconn_composite_attributes(this->connection, 
+		PQftype(this->result, field_num));
+	if(NIL_P(names)) {
+		rb_raise(rb_eArgError, "field %d is not of a named composite type", 
+			field_num);
+	}
+
+	nkeys = RARRAY_LEN(names);
+	keys = names;
+	if(SYM2ID(this->field_name_type) == id_symbol) {
+		keys = rb_ary_new2(nkeys);
+		for(i = 0; i < nkeys; i++) {
+			rb_ary_store(keys, i, 
+				ID2SYM(rb_intern(StringValuePtr(RARRAY_PTR(names)[i]))));
+		}
+	}
+
+	for(tuple_num = 0; tuple_num < ntuples; tuple_num++) {
+		val = rb_ary_entry(ary, tuple_num);
+		if(NIL_P(val))
+			continue;
+		if(RARRAY_LEN(val) != nkeys) {
+			rb_raise(rb_eArgError, "record in tuple %d has %ld attributes, "
+				"expected %ld", tuple_num, (long)RARRAY_LEN(val), nkeys);
+		}
+		hash = rb_hash_new();
+		for(i = 0; i < nkeys; i++) {
+			rb_hash_aset(hash, RARRAY_PTR(keys)[i], RARRAY_PTR(val)[i]);
+		}
+		rb_ary_store(ary, tuple_num, hash);
+	}
+	return ary;
+}
+
+/*
+ * call-seq:
+ *    res.field_name_type() -> Symbol
+ *
+ * Returns the type of the keys of the tuple hashes returned
+ * by #[] and #each: +:string+ (the default) or +:symbol+.
+ */
+static VALUE
+pgresult_get_field_name_type(VALUE self)
+{
+	return get_pgresult_data(self)->field_name_type;
+}
+
+/*
+ * call-seq:
+ *    res.field_name_type = type
+ *
+ * Sets the type of the keys of the tuple hashes returned by
+ * #[] and #each to _type_, which must be +:string+ or +:symbol+.
+ *
+ * Either way, the keys are created only once per result and
+ * shared by all tuples; String keys are frozen.
+ */
+static VALUE
+pgresult_set_field_name_type(VALUE self, VALUE type)
+{
+	t_pgresult *this = get_pgresult_data(self);
+
+	Check_Type(type, T_SYMBOL);
+	if(SYM2ID(type) != id_string && SYM2ID(type) != id_symbol) {
+		rb_raise(rb_eArgError, "invalid field name type: %s",
+			rb_id2name(SYM2ID(type)));
+	}
+	if(type != this->field_name_type) {
+		this->field_name_type = type;
+		this->field_names = Qnil;
+	}
+	return type;
+}
+
+/*
+ * Returns nonzero if the server that produced the result sends
+ * timestamps as integers, which is the default since 8.4.
+ */
+static int
+pgresult_integer_datetimes(t_pgresult *this)
+{
+	PGconn *conn = NULL;
+	const char *setting;
+
+	if(!NIL_P(this->connection))
+		Data_Get_Struct(this->connection, PGconn, conn);
+	if(conn == NULL)
+		return 1;
+	setting = PQparameterStatus(conn, "integer_datetimes");
+	return setting == NULL || strcmp(setting, "on") == 0;
+}
+
+/*
+ * Resolves the decoder for values of type _type_ in _format_ from
+ * the entry _spec_ of a type map Hash. See PGconn#type_map.
+ */
+static void
+resolve_decoder(t_pg_field_decoder *decoder, VALUE spec, Oid type, int format,
+	int integer_datetimes)
+{
+	Oid builtin;
+
+	decoder->func = NULL;
+	decoder->proc = Qnil;
+	if(NIL_P(spec))
+		return;
+	if(SYMBOL_P(spec)) {
+		if(SYM2ID(spec) == id_symbol) {
+			decoder->func = pg_dec_symbol;
+		}
+		else if(SYM2ID(spec) == id_hstore) {
+			decoder->func = format == 0 ? pg_text_dec_hstore : NULL;
+		}
+		else if(SYM2ID(spec) == id_symbol_array) {
+			decoder->func = format == 0 ? pg_text_dec_symbol_array : NULL;
+		}
+		else if(SYM2ID(spec) == id_hstore_array) {
+			decoder->func = format == 0 ? pg_text_dec_hstore_array : NULL;
+		}
+		else if(SYM2ID(spec) != id_string) {
+			builtin = pg_builtin_type_oid(SYM2ID(spec));
+			if(builtin == InvalidOid) {
+				rb_raise(rb_eArgError, "unknown decoder :%s for type %u",
+					rb_id2name(SYM2ID(spec)), type);
+			}
+			decoder->func = format == 0 ? pg_text_decoder(builtin) :
+				pg_bin_decoder(builtin, integer_datetimes);
+		}
+	}
+	else if(rb_respond_to(spec, id_call)) {
+		decoder->proc = spec;
+	}
+	else {
+		rb_raise(rb_eArgError, "invalid decoder for type %u", type);
+	}
+}
+
+/*
+ * Builds the decoder of each field of the result from _type_map_,
+ * which is +:builtin+ or a Hash as for PGconn#type_map, so that
+ * decoding a value only takes a lookup in the decoders array.
+ */
+static void
+compile_type_map(t_pgresult *this, VALUE type_map)
+{
+	int nfields = PQnfields(this->result);
+	int integer_datetimes = pgresult_integer_datetimes(this);
+	t_pg_field_decoder *decoders = ALLOCA_N(t_pg_field_decoder, nfields);
+	int i, format;
+	Oid type;
+
+	if(SYMBOL_P(type_map) && SYM2ID(type_map) == id_builtin) {
+		for(i = 0; i < nfields; i++) {
+			type = PQftype(this->result, i);
+			decoders[i].proc = Qnil;
+			decoders[i].func = PQfformat(this->result, i) == 0 ? 
+				pg_text_decoder(type) : 
+				pg_bin_decoder(type, integer_datetimes);
+		}
+	}
+	else if(TYPE(type_map) == T_HASH) {
+		for(i = 0; i < nfields; i++) {
+			type = PQftype(this->result, i);
+			format = PQfformat(this->result, i);
+			resolve_decoder(&decoders[i], 
+				rb_hash_aref(type_map, UINT2NUM(type)),
+				type, format, integer_datetimes);
+		}
+	}
+	else {
+		rb_raise(rb_eArgError, 
+			"invalid type map (expected :builtin, a Hash or nil)");
+	}
+
+	/* only installed once every entry is known to be valid */
+	xfree(this->decoders);
+	this->decoders = ALLOC_N(t_pg_field_decoder, nfields);
+	MEMCPY(this->decoders, decoders, t_pg_field_decoder, nfields);
+	this->ndecoders = nfields;
+	this->type_map = type_map;
+}
+
+/*
+ * call-seq:
+ *    res.type_map() -> Symbol, Hash or nil
+ *
+ * Returns the type map used to decode values of this result,
+ * or +nil+ if values are returned as Strings. Results get the
+ * type map of their connection, if it has one (see 
+ * PGconn#type_map).
+ */
+static VALUE
+pgresult_get_type_map(VALUE self)
+{
+	return get_pgresult_data(self)->type_map;
+}
+
+/*
+ * call-seq:
+ *    res.type_map = type_map
+ *
+ * Sets how values returned by #getvalue, #[], #each, #values,
+ * #column_values and #field_values are decoded.
+ *
+ * With +:builtin+, values of the following types are converted
+ * by the extension, straight from the libpq buffers:
+ * * +bool+ to +true+ or +false+
+ * * +int2+, +int4+, +int8+ and +oid+ to Integer
+ * * +float4+ and +float8+ to Float
+ * * +date+ to Date
+ * * +timestamp+ to a UTC Time
+ * * +timestamptz+ to a local Time
+ * * +bytea+ to a String of the raw bytes, so PGconn.unescape_bytea
+ *   is not needed
+ * * arrays of all of the above, and of +text+, +varchar+, +bpchar+
+ *   and +name+, to (nested) Arrays; see also #array_values
+ * * +uuid+ to a String in the canonical form
+ * * +inet+ and +cidr+ to IPAddr, except for an +inet+ with a netmask,
+ *   which IPAddr can't represent
+ * * +interval+ to a Float number of seconds, counting months as 30
+ *   days and years as 365.25, like <tt>EXTRACT(EPOCH FROM ...)</tt>
+ * * text format +record+ values to Arrays of Strings; see also
+ *   #record_values
+ * This applies to both text and binary format columns (see #fformat),
+ * so numeric-heavy queries can skip formatting and parsing
+ * altogether by requesting binary results:
+ *
+ *    res = conn.exec("SELECT $1::int8 * 2 AS n", [21], 1)
+ *    res.type_map = :builtin
+ *    res.getvalue(0, 0) # 42
+ *
+ * All other types, and values that can't be represented (such as
+ * +infinity+ or BC dates), are returned as Strings.
+ *
+ * A Hash maps type oids to decoders, as described for 
+ * PGconn#type_map. It is looked up once per field when it is set,
+ * so changing the Hash later doesn't affect the result.
+ *
+ * With +nil+, the default, every value is returned as a String.
+ *
+ *    res = conn.exec("SELECT 1 AS a, 't'::bool AS b")
+ *    res.type_map = :builtin
+ *    res[0] # {"a"=>1, "b"=>true}
+ */
+static VALUE
+pgresult_set_type_map(VALUE self, VALUE type_map)
+{
+	t_pgresult *this = get_pgresult_data(self);
+
+	if(!NIL_P(type_map)) {
+		compile_type_map(this, type_map);
+	}
+	else {
+		xfree(this->decoders);
+		this->decoders = NULL;
+		this->ndecoders = 0;
+		this->type_map = Qnil;
+	}
+	return type_map;
+}
+
+/*
+ * call-seq:
+ *    res.fields() -> Array
+ *
+ * Returns an array of Strings representing the names of the fields in the result.
+ */
+static VALUE
+pgresult_fields(VALUE self)
+{
+	PGresult *result;
+	VALUE ary;
+	int n, i;
+
+	result = get_pgresult(self);
+	n = PQnfields(result);
+	ary = rb_ary_new2(n);
+	for (i=0;i<n;i++) {
+		rb_ary_push(ary, rb_tainted_str_new2(PQfname(result, i)));
+	}
+	return ary;
+}
+
+/********************************************************************
+ * 
+ * Document-class: PGrow
+ *
+ * A single tuple of a PGresult, as yielded by PGresult#each_row.
+ * Values are only read from the result when they are accessed.
+ * A row keeps its result alive, but can't be used after the
+ * result has been cleared.
+ *
+ * Example:
+ *    res = conn.exec('SELECT 1 AS a, 2 AS b')
+ *    res.each_row do |row|
+ *      row[0]     # '1'
+ *      row['b']   # '2'
+ *      row.to_a   # ['1', '2']
+ *      row.to_h   # {'a' => '1', 'b' => '2'}
+ *    end
+ */
+
+static void
+mark_pgrow(t_pgrow *this)
+{
+	rb_gc_mark(this->result);
+}
+
+static void
+free_pgrow(t_pgrow *this)
+{
+	xfree(this);
+}
+
+static t_pgrow*
+get_pgrow(VALUE self)
+{
+	t_pgrow *this;
+	Data_Get_Struct(self, t_pgrow, this);
+	return this;
+}
+
+/*
+ * call-seq:
+ *    row[ n ] -> String
+ *    row[ field ] -> String
+ *
+ * Returns the value of the field with index _n_ or name _field_
+ * (a String or Symbol), or +nil+ if it is +NULL+.
+ *
+ * Raises IndexError if _n_ is out of range, and ArgumentError if
+ * _field_ isn't one of the field names.
+ */
+static VALUE
+pgrow_aref(VALUE self, VALUE index)
+{
+	t_pgrow *this = get_pgrow(self);
+	t_pgresult *res = get_pgresult_data(this->result);
+	int nfields = PQnfields(res->result);
+	int field_num;
+	const char *name;
+
+	if(FIXNUM_P(index)) {
+		field_num = FIX2INT(index);
+		if(field_num < 0 || field_num >= nfields)
+			rb_raise(rb_eIndexError, "Index %d is out of range", field_num);
+	}
+	else {
+		name = SYMBOL_P(index) ? rb_id2name(SYM2ID(index)) : 
+			StringValuePtr(index);
+		for(field_num = 0; field_num < nfields; field_num++) {
+			if(strcmp(PQfname(res->result, field_num), name) == 0)
+				break;
+		}
+		if(field_num == nfields)
+			rb_raise(rb_eArgError, "Unknown field: %s", name);
+	}
+	return pgresult_value(res, this->tuple_num, field_num);
+}
+
+/*
+ * call-seq:
+ *    row.to_a() -> Array
+ *
+ * Returns the values of the row as an Array, in field order.
+ */
+static VALUE
+pgrow_to_a(VALUE self)
+{
+	t_pgrow *this = get_pgrow(self);
+	t_pgresult *res = get_pgresult_data(this->result);
+	int nfields = PQnfields(res->result);
+	int field_num;
+	VALUE ary = rb_ary_new2(nfields);
+
+	for(field_num = 0; field_num < nfields; field_num++) {
+		rb_ary_store(ary, field_num, 
+			pgresult_value(res, this->tuple_num, field_num));
+	}
+	return ary;
+}
+
+/*
+ * call-seq:
+ *    row.to_h() -> Hash
+ *
+ * Returns the row as a Hash, like PGresult#[].
+ */
+static VALUE
+pgrow_to_h(VALUE self)
+{
+	t_pgrow *this = get_pgrow(self);
+	return pgresult_aref(this->result, INT2NUM(this->tuple_num));
+}
+
+/*
+ * call-seq:
+ *    row.tuple_num() -> Fixnum
+ *
+ * Returns the number of the tuple within its result.
+ */
+static VALUE
+pgrow_tuple_num(VALUE self)
+{
+	return INT2NUM(get_pgrow(self)->tuple_num);
+}
+
+/*
+ * call-seq:
+ *    row.result() -> PGresult
+ *
+ * Returns the result this row belongs to.
+ */
+static VALUE
+pgrow_result(VALUE self)
+{
+	return get_pgrow(self)->result;
+}
+
+/********************************************************************
+ * 
+ * Document-class: PGstatement
+ *
+ * A prepared statement, as returned by PGconn#prepare_statement.
+ * The statement is described once, when the PGstatement is created,
+ * so that executing it needs neither the statement name as a Ruby 
+ * String nor a lookup of the result types: the decoders for its 
+ * fields are compiled from the connection's type map ahead of time,
+ * and again only if a different type map is assigned to the 
+ * connection. Changes made to the type map Hash itself are not
+ * seen by existing statements.
+ *
+ * Example:
+ *    stmt = conn.prepare_statement("user_by_id", "SELECT * FROM users WHERE id = $1")
+ *    stmt.param_types   # [23]
+ *    stmt.exec(42)      # like conn.exec_prepared("user_by_id", [42])
+ */
+
+static void
+mark_pgstatement(t_pgstatement *this)
+{
+	rb_gc_mark(this->connection);
+	rb_gc_mark(this->name);
+	rb_gc_mark(this->description);
+}
+
+static void
+free_pgstatement(t_pgstatement *this)
+{
+	xfree(this->param_types);
+	xfree(this);
+}
+
+static t_pgstatement*
+get_pgstatement(VALUE self)
+{
+	t_pgstatement *this;
+	Data_Get_Struct(self, t_pgstatement, this);
+	return this;
+}
+
+/*
+ * Returns the description of the statement _this_, raising PGError 
+ * if it has been cleared (see PGstatement#description).
+ */
+static t_pgresult*
+get_pgstatement_description(t_pgstatement *this)
+{
+	t_pgresult *desc;
+	Data_Get_Struct(this->description, t_pgresult, desc);
+	if(desc->result == NULL)
+		rb_raise(rb_ePGError, "statement description has been cleared");
+	return desc;
+}
+
+static VALUE
+pgstatement_new(VALUE rb_pgconn, VALUE name)
+{
+	t_pgstatement *this;
+	PGresult *desc;
+	VALUE self = Data_Make_Struct(rb_cPGstatement, t_pgstatement,
+		mark_pgstatement, free_pgstatement, this);
+	int i;
+
+	Check_Type(name, T_STRING);
+	this->connection = rb_pgconn;
+	this->name = rb_obj_freeze(rb_str_dup(name));
+	this->description = pgconn_describe_prepared(rb_pgconn, this->name);
+	desc = get_pgresult(this->description);
+	this->nparams = PQnparams(desc);
+	this->param_types = ALLOC_N(Oid, this->nparams);
+	for(i = 0; i < this->nparams; i++)
+		this->param_types[i] = PQparamtype(desc, i);
+	return self;
+}
+
+/*
+ * call-seq:
+ *    PGstatement.new( conn, stmt_name ) -> PGstatement
+ *
+ * Returns a PGstatement for the statement _stmt_name_, which must
+ * already be prepared on _conn_.
+ */
+static VALUE
+pgstatement_s_new(VALUE klass, VALUE rb_pgconn, VALUE name)
+{
+	get_pgconn(rb_pgconn);
+	return pgstatement_new(rb_pgconn, name);
+}
+
+/*
+ * Gives _res_, a result of executing the statement described by 
+ * _desc_, the decoders compiled for the statement, after compiling
+ * them anew if the connection's type map has been replaced since.
+ */
+static void
+statement_decoders(t_pgresult *res, t_pgresult *desc)
+{
+	VALUE type_map = rb_iv_get(res->connection, "@type_map");
+	int nfields = PQnfields(res->result);
+
+	if(NIL_P(type_map) || nfields == 0)
+		return;
+	if(PQnfields(desc->result) != nfields) {
+		compile_type_map(res, type_map);
+		return;
+	}
+	if(desc->type_map != type_map)
+		compile_type_map(desc, type_map);
+	res->decoders = ALLOC_N(t_pg_field_decoder, nfields);
+	MEMCPY(res->decoders, desc->decoders, t_pg_field_decoder, nfields);
+	res->ndecoders = nfields;
+	res->type_map = type_map;
+}
+
+/*
+ * call-seq:
+ *    stmt.exec( *params ) -> PGresult
+ *    stmt.exec( *params ) {|pg_result| block }
+ *
+ * Executes the statement with the bind parameters _params_, which
+ * are given as for PGconn#exec_prepared, and returns the result in
+ * text format. Strings for +bytea+ parameters are sent in binary, 
+ * without escaping.
+ *
+ * Raises ArgumentError unless as many parameters are given as the
+ * statement takes.
+ */
+static VALUE
+pgstatement_exec(int argc, VALUE *argv, VALUE self)
+{
+	t_pgstatement *this = get_pgstatement(self);
+	PGconn *conn = get_pgconn(this->connection);
+	t_pgresult *desc;
+	PGresult *result;
+	VALUE rb_pgresult;
+	t_pg_params p;
+
+	get_pgstatement_description(this);
+	if(argc != this->nparams) {
+		rb_raise(rb_eArgError, "wrong number of parameters (%d for %d)",
+			argc, this->nparams);
+	}
+	marshal_params(&p, rb_ary_new4(argc, argv), this->param_types);
+	/* converting the parameters may have run arbitrary code */
+	desc = get_pgstatement_description(this);
+	result = PQexecPrepared(conn, RSTRING_PTR(this->name), p.nparams, 
+		(const char * const *)p.values, p.lengths, p.formats, 0);
+
+	rb_pgresult = wrap_pgresult(result, this->connection, 1);
+	if(result != NULL)
+		statement_decoders(DATA_PTR(rb_pgresult), desc);
+	pgresult_check(this->connection, rb_pgresult);
+	if (rb_block_given_p()) {
+		return rb_ensure(yield_pgresult, rb_pgresult, 
+			pgresult_clear, rb_pgresult);
+	}
+	return rb_pgresult;
+}
+
+/*
+ * call-seq:
+ *    stmt.name() -> String
+ *
+ * Returns the name of the prepared statement.
+ */
+static VALUE
+pgstatement_name(VALUE self)
+{
+	return get_pgstatement(self)->name;
+}
+
+/*
+ * call-seq:
+ *    stmt.connection() -> PGconn
+ *
+ * Returns the connection the statement is prepared on.
+ */
+static VALUE
+pgstatement_connection(VALUE self)
+{
+	return get_pgstatement(self)->connection;
+}
+
+/*
+ * call-seq:
+ *    stmt.description() -> PGresult
+ *
+ * Returns the description of the statement, as from
+ * PGconn#describe_prepared. The statement can't be executed once
+ * the description has been cleared.
+ */
+static VALUE
+pgstatement_description(VALUE self)
+{
+	return get_pgstatement(self)->description;
+}
+
+/*
+ * call-seq:
+ *    stmt.param_types() -> Array
+ *
+ * Returns the type oids of the parameters of the statement.
+ */
+static VALUE
+pgstatement_param_types(VALUE self)
+{
+	t_pgstatement *this = get_pgstatement(self);
+	VALUE ary = rb_ary_new2(this->nparams);
+	int i;
+
+	get_pgstatement_description(this);
+	for(i = 0; i < this->nparams; i++)
+		rb_ary_store(ary, i, UINT2NUM(this->param_types[i]));
+	return ary;
+}
+
+/**************************************************************************/
+
+void
+Init_pg()
+{
+	rb_ePGError = rb_define_class("PGError", rb_eStandardError);
+	rb_cPGconn = rb_define_class("PGconn", rb_cObject);
+	rb_cPGresult = rb_define_class("PGresult", rb_cObject);
+	rb_cPGrow = rb_define_class("PGrow", rb_cObject);
+	rb_cPGstatement = rb_define_class("PGstatement", rb_cObject);
+
+	id_string = rb_intern("string");
+	id_symbol = rb_intern("symbol");
+	id_builtin = rb_intern("builtin");
+	id_hstore = rb_intern("hstore");
+	id_call = rb_intern("call");
+	id_symbol_array = rb_intern("symbol_array");
+	id_hstore_array = rb_intern("hstore_array");
+	id_lock = rb_intern("lock");
+	id_unlock = rb_intern("unlock");
+	id_replace = rb_intern("replace");
+	id_delimiter = rb_intern("delimiter");
+	id_quote = rb_intern("quote");
+	id_header = rb_intern("header");
+	id_null = rb_intern("null");
+	id_typed = rb_intern("typed");
+	sym_type = ID2SYM(rb_intern("type"));
+	sym_value = ID2SYM(rb_intern("value"));
+	sym_format = ID2SYM(rb_intern("format"));
+	sym_bytea = ID2SYM(rb_intern("bytea"));
+	id_fields = rb_intern("fields");
+	Init_pg_typecast();
+
+	rb_require("thread");
+	rb_global_variable(&type_catalogs);
+	rb_global_variable(&type_catalog_lock);
+	type_catalogs = rb_hash_new();
+	type_catalog_lock = rb_funcall(rb_path2class("Mutex"), rb_intern("new"), 0);
 
 
 	/*************************
@@ -3356,6 +5708,8 @@ Init_pg()
 	rb_define_singleton_alias(rb_cPGconn, "escape", "escape_string");
 	rb_define_singleton_method(rb_cPGconn, "escape_bytea", pgconn_s_escape_bytea, 1);
 	rb_define_singleton_method(rb_cPGconn, "unescape_bytea", pgconn_s_unescape_bytea, 1);
+	rb_define_singleton_method(rb_cPGconn, "encode_hstore", pgconn_s_encode_hstore, 1);
+	rb_define_singleton_method(rb_cPGconn, "decode_hstore", pgconn_s_decode_hstore, 1);
 	rb_define_singleton_method(rb_cPGconn, "isthreadsafe", pgconn_s_isthreadsafe, 0);
 	rb_define_singleton_method(rb_cPGconn, "encrypt_password", pgconn_s_encrypt_password, 0);
 	rb_define_singleton_method(rb_cPGconn, "quote_ident", pgconn_s_quote_ident, 1);
@@ -3399,6 +5753,19 @@ Init_pg()
 	rb_define_const(rb_cPGconn, "SEEK_CUR", INT2FIX(SEEK_CUR));
 	rb_define_const(rb_cPGconn, "SEEK_END", INT2FIX(SEEK_END));
 
+	/******     PGconn CLASS CONSTANTS: Type Maps     ******/
+	/* The oids of the built-in types with decoders, mapped to their
+	 * names. See PGconn#type_map. */
+	rb_define_const(rb_cPGconn, "BUILTIN_TYPES", rb_obj_freeze(pg_builtin_types()));
+	/* The built-in types that bind parameters can name as their +:type+
+	 * (see #exec), and those of their arrays, mapped to their oids:
+	 * bool, bytea, char, name, int2, int4, int8, oid, text, json, jsonb,
+	 * xml, float4, float8, numeric, money, bpchar, varchar, date, time,
+	 * timetz, timestamp, timestamptz, interval, bit, varbit, inet, cidr,
+	 * macaddr, uuid and record. Array types can also be written as 
+	 * e.g. <tt>:"int4[]"</tt>. */
+	rb_define_const(rb_cPGconn, "PARAM_TYPES", rb_obj_freeze(pg_param_types()));
+
 	/******     PGconn INSTANCE METHODS: Connection Control     ******/
 	rb_define_method(rb_cPGconn, "initialize", pgconn_init, -1);
 	rb_define_method(rb_cPGconn, "connect_poll", pgconn_connect_poll, 0);
@@ -3434,6 +5801,7 @@ Init_pg()
 	rb_define_alias(rb_cPGconn, "query", "exec");
 	rb_define_method(rb_cPGconn, "prepare", pgconn_prepare, -1);
 	rb_define_method(rb_cPGconn, "exec_prepared", pgconn_exec_prepared, -1);
+	rb_define_method(rb_cPGconn, "prepare_statement", pgconn_prepare_statement, -1);
 	rb_define_method(rb_cPGconn, "describe_prepared", pgconn_describe_prepared, 1);
 	rb_define_method(rb_cPGconn, "describe_portal", pgconn_describe_portal, 1);
 	rb_define_method(rb_cPGconn, "make_empty_pgresult", pgconn_make_empty_pgresult, 1);
@@ -3441,6 +5809,8 @@ Init_pg()
 	rb_define_alias(rb_cPGconn, "escape", "escape_string");
 	rb_define_method(rb_cPGconn, "escape_bytea", pgconn_s_escape_bytea, 1);
 	rb_define_method(rb_cPGconn, "unescape_bytea", pgconn_s_unescape_bytea, 1);
+	rb_define_method(rb_cPGconn, "encode_hstore", pgconn_s_encode_hstore, 1);
+	rb_define_method(rb_cPGconn, "decode_hstore", pgconn_s_decode_hstore, 1);
 
 	/******     PGconn INSTANCE METHODS: Asynchronous Command Processing     ******/
 	rb_define_method(rb_cPGconn, "send_query", pgconn_send_query, -1);
@@ -3484,6 +5854,10 @@ Init_pg()
 	rb_define_method(rb_cPGconn, "async_exec", pgconn_async_exec, -1);
 	rb_define_alias(rb_cPGconn, "async_query", "async_exec");
 	rb_define_method(rb_cPGconn, "get_last_result", pgconn_get_last_result, 0);
+	rb_define_method(rb_cPGconn, "stream", pgconn_stream, -1);
+	rb_define_method(rb_cPGconn, "type_map", pgconn_get_type_map, 0);
+	rb_define_method(rb_cPGconn, "type_map=", pgconn_set_type_map, 1);
+	rb_define_method(rb_cPGconn, "type_catalog", pgconn_type_catalog, -1);
 
 	/******     PGconn INSTANCE METHODS: Large Object Support     ******/
 	rb_define_method(rb_cPGconn, "lo_creat", pgconn_locreat, -1);
@@ -3522,6 +5896,7 @@ Init_pg()
 	rb_define_const(rb_cPGresult, "PGRES_EMPTY_QUERY", INT2FIX(PGRES_EMPTY_QUERY));
 	rb_define_const(rb_cPGresult, "PGRES_COMMAND_OK", INT2FIX(PGRES_COMMAND_OK));
 	rb_define_const(rb_cPGresult, "PGRES_TUPLES_OK", INT2FIX(PGRES_TUPLES_OK));
+	rb_define_const(rb_cPGresult, "PGRES_SINGLE_TUPLE", INT2FIX(PGRES_SINGLE_TUPLE));
 	rb_define_const(rb_cPGresult, "PGRES_COPY_OUT", INT2FIX(PGRES_COPY_OUT));
 	rb_define_const(rb_cPGresult, "PGRES_COPY_IN", INT2FIX(PGRES_COPY_IN));
 	rb_define_const(rb_cPGresult, "PGRES_BAD_RESPONSE", INT2FIX(PGRES_BAD_RESPONSE));
@@ -3548,6 +5923,7 @@ Init_pg()
 	rb_define_method(rb_cPGresult, "result_error_message", pgresult_result_error_message, 0);
 	rb_define_method(rb_cPGresult, "result_error_field", pgresult_result_error_field, 1);
 	rb_define_method(rb_cPGresult, "clear", pgresult_clear, 0);
+	rb_define_method(rb_cPGresult, "memsize", pgresult_memsize, 0);
 	rb_define_method(rb_cPGresult, "ntuples", pgresult_ntuples, 0);
 	rb_define_alias(rb_cPGresult, "num_tuples", "ntuples");
 	rb_define_method(rb_cPGresult, "nfields", pgresult_nfields, 0);
@@ -3572,7 +5948,46 @@ Init_pg()
 
 	/******     PGresult INSTANCE METHODS: other     ******/
 	rb_define_method(rb_cPGresult, "[]", pgresult_aref, 1);
-	rb_define_method(rb_cPGresult, "each", pgresult_each, 0);
+	rb_define_method(rb_cPGresult, "each", pgresult_each, -1);
+	rb_define_method(rb_cPGresult, "each_row", pgresult_each_row, 0);
+	rb_define_method(rb_cPGresult, "index_by_field", pgresult_index_by_field, -1);
+	rb_define_method(rb_cPGresult, "group_by_field", pgresult_group_by_field, -1);
+	rb_define_method(rb_cPGresult, "each_row_reuse", pgresult_each_row_reuse, 0);
+	rb_define_method(rb_cPGresult, "values", pgresult_values, -1);
+	rb_define_method(rb_cPGresult, "column_values", pgresult_column_values, 1);
+	rb_define_method(rb_cPGresult, "field_values", pgresult_field_values, 1);
+	rb_define_method(rb_cPGresult, "array_values", pgresult_array_values, 1);
+	rb_define_method(rb_cPGresult, "record_values", pgresult_record_values, 1);
+	rb_define_method(rb_cPGresult, "record_hashes", pgresult_record_hashes, 1);
+	rb_define_method(rb_cPGresult, "hstore_values", pgresult_hstore_values, 1);
+	rb_define_method(rb_cPGresult, "write_csv", pgresult_write_csv, -1);
+	rb_define_method(rb_cPGresult, "dump", pgresult_dump, 0);
+	rb_define_singleton_method(rb_cPGresult, "load", pgresult_s_load, 1);
 	rb_define_method(rb_cPGresult, "fields", pgresult_fields, 0);
+	rb_define_method(rb_cPGresult, "field_name_type", pgresult_get_field_name_type, 0);
+	rb_define_method(rb_cPGresult, "field_name_type=", pgresult_set_field_name_type, 1);
+	rb_define_method(rb_cPGresult, "type_map", pgresult_get_type_map, 0);
+	rb_define_method(rb_cPGresult, "type_map=", pgresult_set_type_map, 1);
+
+	/*************************
+	 *  PGrow 
+	 *************************/
+	rb_undef_alloc_func(rb_cPGrow);
+	rb_define_method(rb_cPGrow, "[]", pgrow_aref, 1);
+	rb_define_method(rb_cPGrow, "to_a", pgrow_to_a, 0);
+	rb_define_method(rb_cPGrow, "to_h", pgrow_to_h, 0);
+	rb_define_method(rb_cPGrow, "tuple_num", pgrow_tuple_num, 0);
+	rb_define_method(rb_cPGrow, "result", pgrow_result, 0);
+
+	/*************************
+	 *  PGstatement 
+	 *************************/
+	rb_undef_alloc_func(rb_cPGstatement);
+	rb_define_singleton_method(rb_cPGstatement, "new", pgstatement_s_new, 2);
+	rb_define_method(rb_cPGstatement, "exec", pgstatement_exec, -1);
+	rb_define_method(rb_cPGstatement, "name", pgstatement_name, 0);
+	rb_define_method(rb_cPGstatement, "connection", pgstatement_connection, 0);
+	rb_define_method(rb_cPGstatement, "description", pgstatement_description, 0);
+	rb_define_method(rb_cPGstatement, "param_types", pgstatement_param_types, 0);
 
 }
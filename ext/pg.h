@@ -8,6 +8,7 @@
 #include "libpq/libpq-fs.h"              /* large-object interface */
 
 #include "compat.h"
+#include "typecast.h"
 
 #if RUBY_VM != 1
 #define RUBY_18_COMPAT
@@ -25,6 +26,10 @@
 #define RSTRING_PTR(x) RSTRING((x))->ptr
 #endif /* RSTRING_PTR */
 
+#ifndef HAVE_RB_STR_SET_LEN
+#define rb_str_set_len(x, n) (RSTRING((x))->len = (n))
+#endif /* HAVE_RB_STR_SET_LEN */
+
 #ifndef StringValuePtr
 #define StringValuePtr(x) STR2CSTR(x)
 #endif /* StringValuePtr */
@@ -0,0 +1,1521 @@
+/************************************************
+
+  typecast.c -
+
+  Decoders from the PostgreSQL text (and binary) output
+  formats of built-in types to ruby objects. They work directly
+  on the buffers owned by the PGresult, without creating an
+  intermediate String.
+
+************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "typecast.h"
+
+/* Seconds between the unix epoch and the PostgreSQL epoch, 2000-01-01 */
+#define POSTGRES_EPOCH_SECS 946684800L
+#define POSTGRES_EPOCH_DAYS 10957
+
+static VALUE rb_cDate = Qnil;
+static VALUE rb_cIPAddr = Qnil;
+static VALUE af_inet, af_inet6;
+static ID id_new;
+static ID id_utc;
+static ID id_mask;
+static ID id_lshift;
+static ID id_or;
+static ID id_jd;
+
+static VALUE
+new_date(int year, int month, int day)
+{
+	if(NIL_P(rb_cDate)) {
+		rb_require("date");
+		rb_cDate = rb_const_get(rb_cObject, rb_intern("Date"));
+	}
+	return rb_funcall(rb_cDate, id_new, 3, INT2FIX(year), INT2FIX(month),
+		INT2FIX(day));
+}
+
+/*
+ * Loads IPAddr the first time an address is decoded.
+ */
+static void
+require_ipaddr(void)
+{
+	VALUE socket;
+
+	if(NIL_P(rb_cIPAddr)) {
+		rb_require("ipaddr");
+		rb_cIPAddr = rb_const_get(rb_cObject, rb_intern("IPAddr"));
+		socket = rb_const_get(rb_cObject, rb_intern("Socket"));
+		af_inet = rb_const_get(socket, rb_intern("AF_INET"));
+		af_inet6 = rb_const_get(socket, rb_intern("AF_INET6"));
+	}
+}
+
+/*
+ * Returns an IPAddr for the address _addr_ (an Integer), masked to
+ * _bits_ if that is shorter than the address.
+ */
+static VALUE
+new_ipaddr(VALUE addr, int ipv6, int bits)
+{
+	VALUE ip;
+
+	require_ipaddr();
+	ip = rb_funcall(rb_cIPAddr, id_new, 2, addr, ipv6 ? af_inet6 : af_inet);
+	if(bits < (ipv6 ? 128 : 32))
+		ip = rb_funcall(ip, id_mask, 1, INT2FIX(bits));
+	return ip;
+}
+
+/*
+ * The number of seconds in an interval, counting a month as 30 days
+ * and a year as 365.25 days, as <tt>EXTRACT(EPOCH FROM ...)</tt> does.
+ */
+static VALUE
+interval_seconds(double secs, long days, long months)
+{
+	return rb_float_new(secs + 86400.0 * days + 
+		365.25 * 86400.0 * (months / 12) + 30 * 86400.0 * (months % 12));
+}
+
+/*
+ * Parses exactly _n_ decimal digits at _p_ into _out_.
+ * Returns 0 if any of them isn't a digit.
+ */
+static int
+parse_digits(const char *p, int n, int *out)
+{
+	int i, val = 0;
+	for(i = 0; i < n; i++) {
+		if(p[i] < '0' || p[i] > '9')
+			return 0;
+		val = val * 10 + (p[i] - '0');
+	}
+	*out = val;
+	return 1;
+}
+
+/*
+ * Number of days between 1970-01-01 and the given date of the
+ * proleptic Gregorian calendar, and the reverse.
+ */
+static long
+days_from_civil(long year, int month, int day)
+{
+	long era, yoe, doy, doe;
+
+	year -= month <= 2;
+	era = (year >= 0 ? year : year - 399) / 400;
+	yoe = year - era * 400;
+	doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+static void
+civil_from_days(long days, int *year, int *month, int *day)
+{
+	long era, doe, yoe, doy, mp;
+
+	days += 719468;
+	era = (days >= 0 ? days : days - 146096) / 146097;
+	doe = days - era * 146097;
+	yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	mp = (5 * doy + 2) / 153;
+	*day = (int)(doy - (153 * mp + 2) / 5 + 1);
+	*month = (int)(mp < 10 ? mp + 3 : mp - 9);
+	*year = (int)(yoe + era * 400 + (*month <= 2));
+}
+
+/*
+ * Parses an ISO date "YYYY-MM-DD". Anything else (BC dates, years
+ * beyond 9999, infinity, other DateStyles) is rejected.
+ */
+static int
+parse_date(const char *p, int len, int *year, int *month, int *day)
+{
+	if(len < 10 || p[4] != '-' || p[7] != '-')
+		return 0;
+	return parse_digits(p, 4, year) && parse_digits(p + 5, 2, month) &&
+		parse_digits(p + 8, 2, day);
+}
+
+/*
+ * Parses an ISO timestamp "YYYY-MM-DD HH:MM:SS[.ffffff][+HH[:MM[:SS]]]"
+ * into seconds and microseconds since the epoch. A time zone offset,
+ * if present, is applied; otherwise the time is taken as UTC.
+ */
+static int
+parse_timestamp(const char *p, int len, time_t *sec, long *usec)
+{
+	int year, month, day, hour, min, secs;
+	int tz_hour = 0, tz_min = 0, tz_sec = 0, tz_sign;
+	int i = 19, scale = 100000;
+	long offset;
+
+	if(len < 19 || !parse_date(p, len, &year, &month, &day) || p[10] != ' ' ||
+			p[13] != ':' || p[16] != ':' || !parse_digits(p + 11, 2, &hour) ||
+			!parse_digits(p + 14, 2, &min) || !parse_digits(p + 17, 2, &secs))
+		return 0;
+
+	*usec = 0;
+	if(i < len && p[i] == '.') {
+		for(i++; i < len && p[i] >= '0' && p[i] <= '9'; i++) {
+			*usec += (p[i] - '0') * scale;
+			scale /= 10;
+		}
+	}
+
+	offset = 0;
+	if(i < len && (p[i] == '+' || p[i] == '-')) {
+		tz_sign = p[i] == '-' ? -1 : 1;
+		if(i + 3 > len || !parse_digits(p + i + 1, 2, &tz_hour))
+			return 0;
+		i += 3;
+		if(i < len && p[i] == ':') {
+			if(i + 3 > len || !parse_digits(p + i + 1, 2, &tz_min))
+				return 0;
+			i += 3;
+		}
+		if(i < len && p[i] == ':') {
+			if(i + 3 > len || !parse_digits(p + i + 1, 2, &tz_sec))
+				return 0;
+			i += 3;
+		}
+		offset = tz_sign * (tz_hour * 3600L + tz_min * 60L + tz_sec);
+	}
+	if(i != len)
+		return 0;
+
+	*sec = (time_t)(days_from_civil(year, month, day) * 86400L +
+		hour * 3600L + min * 60L + secs - offset);
+	return 1;
+}
+
+/**************************************************************************
+ * TEXT FORMAT DECODERS
+ **************************************************************************/
+
+static VALUE
+pg_text_dec_boolean(const char *value, int length)
+{
+	if(length != 1)
+		return Qundef;
+	return *value == 't' ? Qtrue : Qfalse;
+}
+
+static VALUE
+pg_text_dec_integer(const char *value, int length)
+{
+	const char *p = value, *end = value + length;
+	unsigned LONG_LONG val = 0;
+	int negative = 0;
+
+	if(p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+	if(p == end || end - p > 19)
+		return Qundef;
+	for(; p < end; p++) {
+		if(*p < '0' || *p > '9')
+			return Qundef;
+		val = val * 10 + (*p - '0');
+	}
+	if(negative)
+		return LL2NUM((LONG_LONG)(0 - val));
+	return ULL2NUM(val);
+}
+
+static VALUE
+pg_text_dec_float(const char *value, int length)
+{
+	char *end;
+	double val = strtod(value, &end);
+	if(end != value + length)
+		return Qundef;
+	return rb_float_new(val);
+}
+
+static VALUE
+pg_text_dec_date(const char *value, int length)
+{
+	int year, month, day;
+
+	if(length != 10 || !parse_date(value, length, &year, &month, &day))
+		return Qundef;
+	return new_date(year, month, day);
+}
+
+/*
+ * timestamp without time zone: the wall clock time is returned
+ * as a UTC Time, since there is no zone to interpret it in.
+ */
+static VALUE
+pg_text_dec_timestamp(const char *value, int length)
+{
+	time_t sec;
+	long usec;
+
+	if(!parse_timestamp(value, length, &sec, &usec))
+		return Qundef;
+	return rb_funcall(rb_time_new(sec, usec), id_utc, 0);
+}
+
+/*
+ * timestamp with time zone: the offset sent by the server (in the
+ * session's TimeZone) is applied and a local Time returned.
+ */
+static VALUE
+pg_text_dec_timestamptz(const char *value, int length)
+{
+	time_t sec;
+	long usec;
+
+	if(!parse_timestamp(value, length, &sec, &usec))
+		return Qundef;
+	return rb_time_new(sec, usec);
+}
+
+/*
+ * inet and cidr: an IPAddr. IPAddr can't carry the host part of an
+ * inet with a netmask, such as 192.168.0.1/24, so those are left as
+ * Strings.
+ */
+static VALUE
+dec_inet_text(const char *value, int length, int is_cidr)
+{
+	const char *p = value, *end = value + length, *slash;
+	unsigned int addr = 0, octet;
+	int i, bits = 32;
+
+	slash = memchr(value, '/', length);
+	if(slash && !is_cidr)
+		return Qundef;
+	if(memchr(value, ':', length)) {
+		require_ipaddr();
+		return rb_funcall(rb_cIPAddr, id_new, 1, rb_str_new(value, length));
+	}
+
+	for(i = 0; i < 4; i++) {
+		octet = 0;
+		if(p == end || *p < '0' || *p > '9')
+			return Qundef;
+		while(p < end && *p >= '0' && *p <= '9')
+			octet = octet * 10 + (*p++ - '0');
+		if(octet > 255 || (i < 3 && (p == end || *p++ != '.')))
+			return Qundef;
+		addr = addr << 8 | octet;
+	}
+	if(p < end) {
+		if(*p++ != '/' || p == end || end - p > 2)
+			return Qundef;
+		for(bits = 0; p < end; p++) {
+			if(*p < '0' || *p > '9')
+				return Qundef;
+			bits = bits * 10 + (*p - '0');
+		}
+		if(bits > 32)
+			return Qundef;
+	}
+	return new_ipaddr(UINT2NUM(addr), 0, bits);
+}
+
+static VALUE
+pg_text_dec_inet(const char *value, int length)
+{
+	return dec_inet_text(value, length, 0);
+}
+
+static VALUE
+pg_text_dec_cidr(const char *value, int length)
+{
+	return dec_inet_text(value, length, 1);
+}
+
+/*
+ * interval: a Float number of seconds (see interval_seconds). Only
+ * the default +postgres+ IntervalStyle, as in 
+ * "1 year 2 mons -3 days +04:05:06.5", is understood; values in
+ * other styles are left as Strings.
+ */
+static VALUE
+pg_text_dec_interval(const char *value, int length)
+{
+	const char *p = value, *end = value + length, *unit;
+	long num, days = 0, months = 0;
+	int negative, hours_seen = 0, min, sec, n;
+	double secs = 0, frac, scale;
+
+	while(p < end) {
+		if(*p == ' ') {
+			p++;
+			continue;
+		}
+		negative = 0;
+		if(*p == '-' || *p == '+')
+			negative = *p++ == '-';
+		if(p == end || *p < '0' || *p > '9')
+			return Qundef;
+		for(num = 0, n = 0; p < end && *p >= '0' && *p <= '9'; p++, n++)
+			num = num * 10 + (*p - '0');
+		if(n > 9)
+			return Qundef;
+
+		if(p < end && *p == ':') {
+			/* hh:mm:ss[.ffffff], the hours may exceed 24 */
+			if(hours_seen++ || end - p < 6 || 
+					!parse_digits(p + 1, 2, &min) || p[3] != ':' ||
+					!parse_digits(p + 4, 2, &sec))
+				return Qundef;
+			p += 6;
+			frac = 0;
+			if(p < end && *p == '.') {
+				for(p++, scale = 0.1; p < end && *p >= '0' && *p <= '9'; p++) {
+					frac += (*p - '0') * scale;
+					scale /= 10;
+				}
+			}
+			frac += num * 3600.0 + min * 60 + sec;
+			secs += negative ? -frac : frac;
+			continue;
+		}
+
+		if(negative)
+			num = -num;
+		if(p == end || *p++ != ' ')
+			return Qundef;
+		for(unit = p; p < end && *p >= 'a' && *p <= 'z'; p++)
+			;
+		n = (int)(p - unit);
+		if((n == 4 || n == 5) && strncmp(unit, "year", 4) == 0)
+			months += num * 12;
+		else if((n == 3 || n == 4) && strncmp(unit, "mon", 3) == 0)
+			months += num;
+		else if((n == 3 || n == 4) && strncmp(unit, "day", 3) == 0)
+			days += num;
+		else
+			return Qundef;
+	}
+	if(p == value)
+		return Qundef;
+	return interval_seconds(secs, days, months);
+}
+
+static int
+hex_digit(char c)
+{
+	if(c >= '0' && c <= '9')
+		return c - '0';
+	if(c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+	if(c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+#define IS_OCTAL(c) ((c) >= '0' && (c) <= '7')
+
+/*
+ * bytea, in either the hex format ("\x4142") of 9.0 and later
+ * or the older escape format ("AB\000\\"). The value is decoded
+ * straight into a String of the right size.
+ */
+static VALUE
+pg_text_dec_bytea(const char *value, int length)
+{
+	VALUE str;
+	char *out;
+	int i, hi, lo, outlen;
+
+	if(length >= 2 && value[0] == '\\' && value[1] == 'x') {
+		if(length % 2 != 0)
+			return Qundef;
+		str = rb_str_new(NULL, (length - 2) / 2);
+		out = RSTRING_PTR(str);
+		for(i = 2; i < length; i += 2) {
+			hi = hex_digit(value[i]);
+			lo = hex_digit(value[i + 1]);
+			if(hi < 0 || lo < 0)
+				return Qundef;
+			*out++ = (char)(hi << 4 | lo);
+		}
+		return str;
+	}
+
+	/* escape format: count first, so the String is allocated once */
+	for(i = 0, outlen = 0; i < length; outlen++) {
+		if(value[i] != '\\')
+			i++;
+		else if(i + 1 < length && value[i + 1] == '\\')
+			i += 2;
+		else if(i + 3 < length && IS_OCTAL(value[i + 1]) && 
+				IS_OCTAL(value[i + 2]) && IS_OCTAL(value[i + 3]))
+			i += 4;
+		else
+			return Qundef;
+	}
+	str = rb_str_new(NULL, outlen);
+	out = RSTRING_PTR(str);
+	for(i = 0; i < length; ) {
+		if(value[i] != '\\') {
+			*out++ = value[i++];
+		}
+		else if(value[i + 1] == '\\') {
+			*out++ = '\\';
+			i += 2;
+		}
+		else {
+			*out++ = (char)((value[i + 1] - '0') << 6 | 
+				(value[i + 2] - '0') << 3 | (value[i + 3] - '0'));
+			i += 4;
+		}
+	}
+	return str;
+}
+
+/* arrays may have at most this many dimensions (MAXDIM on the server) */
+#define ARRAY_MAXDIM 6
+
+/*
+ * Parses the array literal at *_pp_, which must start with '{', up to
+ * and including its closing '}', and advances *_pp_ past it. Elements
+ * are unescaped into _buf_ and converted with _element_ (Strings if
+ * it is NULL). _depth_ is the dimension being parsed, starting at 1.
+ * Returns Qundef if the literal is malformed or nested too deeply.
+ */
+static VALUE
+parse_array(const char **pp, const char *end, char *buf, t_pg_decoder element,
+	char delim, int depth)
+{
+	const char *p = *pp + 1;
+	VALUE ary = rb_ary_new();
+	VALUE val;
+	int n, quoted, escaped;
+
+	if(depth > ARRAY_MAXDIM)
+		return Qundef;
+	if(p < end && *p == '}') {
+		*pp = p + 1;
+		return ary;
+	}
+	for(;;) {
+		if(p >= end)
+			return Qundef;
+		if(*p == '{') {
+			val = parse_array(&p, end, buf, element, delim, depth + 1);
+			if(val == Qundef)
+				return Qundef;
+		}
+		else {
+			n = 0;
+			escaped = 0;
+			quoted = *p == '"';
+			if(quoted)
+				p++;
+			while(p < end && (quoted ? *p != '"' : (*p != delim && *p != '}'))) {
+				if(*p == '\\') {
+					escaped = 1;
+					if(++p == end)
+						return Qundef;
+				}
+				buf[n++] = *p++;
+			}
+			if(quoted) {
+				if(p == end)
+					return Qundef;
+				p++;
+			}
+			buf[n] = '\0';
+			if(!quoted && !escaped && n == 4 && toupper(buf[0]) == 'N' &&
+					toupper(buf[1]) == 'U' && toupper(buf[2]) == 'L' && 
+					toupper(buf[3]) == 'L') {
+				val = Qnil;
+			}
+			else {
+				val = element ? element(buf, n) : Qundef;
+				if(val == Qundef)
+					val = rb_str_new(buf, n);
+			}
+		}
+		rb_ary_push(ary, val);
+
+		if(p >= end)
+			return Qundef;
+		if(*p == '}')
+			break;
+		if(*p != delim)
+			return Qundef;
+		p++;
+	}
+	*pp = p + 1;
+	return ary;
+}
+
+/*
+ * Decodes an array literal such as "{1,2,NULL}" or "{{a,\"b c\"},{d,e}}"
+ * into a (nested) Array, converting the elements with _element_, or
+ * to Strings if it is NULL. _delim_ separates the elements; it is
+ * ',' for all built-in types except +box+. Returns Qundef if the
+ * value is not a well-formed array literal.
+ */
+VALUE
+pg_text_dec_array(const char *value, int length, t_pg_decoder element, char delim)
+{
+	const char *p = value, *end = value + length;
+	VALUE buf, ary;
+
+	/* skip dimension decoration, as in "[0:1]={1,2}" */
+	if(p < end && *p == '[') {
+		while(p < end && *p != '=')
+			p++;
+		p++;
+	}
+	if(p >= end || *p != '{')
+		return Qundef;
+
+	/* no element can be longer than the whole literal */
+	buf = rb_str_new(NULL, length + 1);
+	ary = parse_array(&p, end, RSTRING_PTR(buf), element, delim, 1);
+	RB_GC_GUARD(buf);
+	if(p != end)
+		return Qundef;
+	return ary;
+}
+
+#define DEFINE_ARRAY_DECODER(name, element) \
+	static VALUE \
+	pg_text_dec_##name##_array(const char *value, int length) \
+	{ \
+		return pg_text_dec_array(value, length, element, ','); \
+	}
+
+DEFINE_ARRAY_DECODER(text, NULL)
+DEFINE_ARRAY_DECODER(boolean, pg_text_dec_boolean)
+DEFINE_ARRAY_DECODER(integer, pg_text_dec_integer)
+DEFINE_ARRAY_DECODER(float, pg_text_dec_float)
+DEFINE_ARRAY_DECODER(bytea, pg_text_dec_bytea)
+DEFINE_ARRAY_DECODER(date, pg_text_dec_date)
+DEFINE_ARRAY_DECODER(timestamp, pg_text_dec_timestamp)
+DEFINE_ARRAY_DECODER(timestamptz, pg_text_dec_timestamptz)
+
+/*
+ * Returns the decoder for text format arrays of type _type_. Types
+ * that aren't known array types get a decoder returning the
+ * elements as Strings.
+ */
+t_pg_decoder
+pg_text_array_decoder(Oid type)
+{
+	switch(type) {
+	case BOOLARRAYOID:
+		return pg_text_dec_boolean_array;
+	case BYTEAARRAYOID:
+		return pg_text_dec_bytea_array;
+	case INT2ARRAYOID:
+	case INT4ARRAYOID:
+	case INT8ARRAYOID:
+	case OIDARRAYOID:
+		return pg_text_dec_integer_array;
+	case FLOAT4ARRAYOID:
+	case FLOAT8ARRAYOID:
+		return pg_text_dec_float_array;
+	case DATEARRAYOID:
+		return pg_text_dec_date_array;
+	case TIMESTAMPARRAYOID:
+		return pg_text_dec_timestamp_array;
+	case TIMESTAMPTZARRAYOID:
+		return pg_text_dec_timestamptz_array;
+	default:
+		return pg_text_dec_text_array;
+	}
+}
+
+/*
+ * Decodes the text output of a composite type or anonymous record,
+ * such as <tt>(1,"foo bar",,t)</tt>, into an Array of Strings. An
+ * empty unquoted attribute is +NULL+ and becomes +nil+, while ""
+ * is the empty String. Returns Qundef if the value is malformed.
+ */
+VALUE
+pg_text_dec_record(const char *value, int length)
+{
+	const char *p = value + 1, *end = value + length - 1;
+	VALUE ary = rb_ary_new();
+	VALUE buf;
+	char *out;
+	int n, quoted, in_quotes;
+
+	if(length < 2 || value[0] != '(' || value[length - 1] != ')')
+		return Qundef;
+	if(p == end)
+		return ary;
+
+	buf = rb_str_new(NULL, length);
+	out = RSTRING_PTR(buf);
+	for(;;) {
+		n = 0;
+		quoted = in_quotes = 0;
+		while(p < end && (in_quotes || *p != ',')) {
+			if(*p == '\\') {
+				if(++p == end)
+					return Qundef;
+				out[n++] = *p++;
+			}
+			else if(*p == '"') {
+				if(in_quotes && p + 1 < end && p[1] == '"') {
+					out[n++] = '"';
+					p += 2;
+				}
+				else {
+					quoted = 1;
+					in_quotes = !in_quotes;
+					p++;
+				}
+			}
+			else {
+				out[n++] = *p++;
+			}
+		}
+		if(in_quotes)
+			return Qundef;
+		rb_ary_push(ary, (n == 0 && !quoted) ? Qnil : rb_str_new(out, n));
+		if(p == end)
+			break;
+		p++;
+	}
+	RB_GC_GUARD(buf);
+	return ary;
+}
+
+/*
+ * Reads one hstore key or value at *_pp_ into _buf_ and advances *_pp_
+ * past it. Sets *_quoted_ if it was double quoted. Returns its length,
+ * or -1 if it is malformed.
+ */
+static int
+parse_hstore_token(const char **pp, const char *end, char *buf, int *quoted)
+{
+	const char *p = *pp;
+	int n = 0;
+
+	*quoted = p < end && *p == '"';
+	if(*quoted) {
+		for(p++; p < end && *p != '"'; ) {
+			if(*p == '\\' && ++p == end)
+				return -1;
+			buf[n++] = *p++;
+		}
+		if(p == end)
+			return -1;
+		p++;
+	}
+	else {
+		while(p < end && !isspace((unsigned char)*p) && *p != '=' && *p != ',') {
+			if(*p == '\\' && ++p == end)
+				return -1;
+			buf[n++] = *p++;
+		}
+		if(n == 0)
+			return -1;
+	}
+	*pp = p;
+	return n;
+}
+
+#define SKIP_SPACE(p, end) \
+	while((p) < (end) && isspace((unsigned char)*(p))) (p)++
+
+/*
+ * Decodes the text output of an hstore, such as 
+ * <tt>"k"=>"v", "k2"=>NULL</tt>, into a Hash of Strings. +NULL+ 
+ * values become +nil+. Returns Qundef if the value is malformed.
+ */
+VALUE
+pg_text_dec_hstore(const char *value, int length)
+{
+	const char *p = value, *end = value + length;
+	VALUE hash = rb_hash_new();
+	VALUE buf, key, val;
+	char *out;
+	int n, quoted;
+
+	buf = rb_str_new(NULL, length);
+	out = RSTRING_PTR(buf);
+	SKIP_SPACE(p, end);
+	while(p < end) {
+		if((n = parse_hstore_token(&p, end, out, &quoted)) < 0)
+			return Qundef;
+		key = rb_str_new(out, n);
+
+		SKIP_SPACE(p, end);
+		if(end - p < 2 || p[0] != '=' || p[1] != '>')
+			return Qundef;
+		p += 2;
+		SKIP_SPACE(p, end);
+
+		if((n = parse_hstore_token(&p, end, out, &quoted)) < 0)
+			return Qundef;
+		if(!quoted && n == 4 && toupper(out[0]) == 'N' && 
+				toupper(out[1]) == 'U' && toupper(out[2]) == 'L' && 
+				toupper(out[3]) == 'L') {
+			val = Qnil;
+		}
+		else {
+			val = rb_str_new(out, n);
+		}
+		rb_hash_aset(hash, key, val);
+
+		SKIP_SPACE(p, end);
+		if(p < end) {
+			if(*p != ',')
+				return Qundef;
+			p++;
+			SKIP_SPACE(p, end);
+		}
+	}
+	RB_GC_GUARD(buf);
+	return hash;
+}
+
+/*
+ * Appends _str_ to _out_ in double quotes, escaping quotes and
+ * backslashes.
+ */
+static void
+append_quoted(VALUE out, VALUE str)
+{
+	const char *p = RSTRING_PTR(str), *end = p + RSTRING_LEN(str);
+	const char *run = p;
+
+	rb_str_cat(out, "\"", 1);
+	for(; p < end; p++) {
+		if(*p == '"' || *p == '\\') {
+			rb_str_cat(out, run, p - run);
+			rb_str_cat(out, "\\", 1);
+			run = p;
+		}
+	}
+	rb_str_cat(out, run, p - run);
+	rb_str_cat(out, "\"", 1);
+}
+
+static int
+enc_hstore_pair(VALUE key, VALUE val, VALUE out)
+{
+	if(key == Qundef)
+		return ST_CONTINUE;
+	if(RSTRING_LEN(out) > 0)
+		rb_str_cat(out, ", ", 2);
+	append_quoted(out, rb_obj_as_string(key));
+	rb_str_cat(out, "=>", 2);
+	if(NIL_P(val))
+		rb_str_cat(out, "NULL", 4);
+	else
+		append_quoted(out, rb_obj_as_string(val));
+	return ST_CONTINUE;
+}
+
+/*
+ * Encodes _hash_ as an hstore literal. Keys and values are converted
+ * with #to_s; +nil+ values become +NULL+.
+ */
+VALUE
+pg_text_enc_hstore(VALUE hash)
+{
+	VALUE out = rb_str_new(NULL, 0);
+
+	Check_Type(hash, T_HASH);
+	rb_hash_foreach(hash, enc_hstore_pair, out);
+	return out;
+}
+
+static void
+enc_array_elements(VALUE out, VALUE ary, int depth)
+{
+	char buf[PG_ENC_BUFSIZE];
+	long i;
+	int len;
+
+	if(depth > ARRAY_MAXDIM)
+		rb_raise(rb_eArgError, "array nested too deeply");
+	rb_str_cat(out, "{", 1);
+	for(i = 0; i < RARRAY_LEN(ary); i++) {
+		VALUE elem = rb_ary_entry(ary, i);
+
+		if(i > 0)
+			rb_str_cat(out, ",", 1);
+		switch(TYPE(elem)) {
+		case T_NIL:
+			rb_str_cat(out, "NULL", 4);
+			break;
+		case T_ARRAY:
+			enc_array_elements(out, elem, depth + 1);
+			break;
+		case T_FIXNUM:
+			len = pg_text_enc_integer(FIX2LONG(elem), buf);
+			rb_str_cat(out, buf, len);
+			break;
+		case T_FLOAT:
+			len = pg_text_enc_float(NUM2DBL(elem), buf);
+			rb_str_cat(out, buf, len);
+			break;
+		case T_TRUE:
+			rb_str_cat(out, "t", 1);
+			break;
+		case T_FALSE:
+			rb_str_cat(out, "f", 1);
+			break;
+		case T_HASH:
+			append_quoted(out, pg_text_enc_hstore(elem));
+			break;
+		case T_STRING:
+			append_quoted(out, elem);
+			break;
+		default:
+			if(rb_obj_is_kind_of(elem, rb_cTime))
+				len = pg_text_enc_time(elem, buf);
+			else
+				len = pg_text_enc_date(elem, buf);
+			if(len >= 0) {
+				rb_str_cat(out, "\"", 1);
+				rb_str_cat(out, buf, len);
+				rb_str_cat(out, "\"", 1);
+			}
+			else {
+				append_quoted(out, rb_obj_as_string(elem));
+			}
+		}
+	}
+	rb_str_cat(out, "}", 1);
+}
+
+/*
+ * Returns _ary_ as an array literal, such as {1,2,NULL} or 
+ * {{"a","b"},{"c","d"}}. Nested Arrays become further dimensions.
+ * Elements are written the way they would be as bind parameters, 
+ * and Hashes as hstore literals.
+ */
+VALUE
+pg_text_enc_array(VALUE ary)
+{
+	VALUE out = rb_str_buf_new(RARRAY_LEN(ary) * 8 + 2);
+
+	Check_Type(ary, T_ARRAY);
+	enc_array_elements(out, ary, 1);
+	return out;
+}
+
+/*
+ * Returns the decoder for text format values of type _type_, or
+ * NULL if values of that type are best returned as a String.
+ */
+t_pg_decoder
+pg_text_decoder(Oid type)
+{
+	switch(type) {
+	case BOOLOID:
+		return pg_text_dec_boolean;
+	case BYTEAOID:
+		return pg_text_dec_bytea;
+	case INT2OID:
+	case INT4OID:
+	case INT8OID:
+	case OIDOID:
+		return pg_text_dec_integer;
+	case FLOAT4OID:
+	case FLOAT8OID:
+		return pg_text_dec_float;
+	case DATEOID:
+		return pg_text_dec_date;
+	case TIMESTAMPOID:
+		return pg_text_dec_timestamp;
+	case TIMESTAMPTZOID:
+		return pg_text_dec_timestamptz;
+	case RECORDOID:
+		return pg_text_dec_record;
+	case INETOID:
+		return pg_text_dec_inet;
+	case CIDROID:
+		return pg_text_dec_cidr;
+	case INTERVALOID:
+		return pg_text_dec_interval;
+	case BOOLARRAYOID:
+	case BYTEAARRAYOID:
+	case NAMEARRAYOID:
+	case INT2ARRAYOID:
+	case INT4ARRAYOID:
+	case TEXTARRAYOID:
+	case BPCHARARRAYOID:
+	case VARCHARARRAYOID:
+	case INT8ARRAYOID:
+	case FLOAT4ARRAYOID:
+	case FLOAT8ARRAYOID:
+	case OIDARRAYOID:
+	case TIMESTAMPARRAYOID:
+	case DATEARRAYOID:
+	case TIMESTAMPTZARRAYOID:
+		return pg_text_array_decoder(type);
+	default:
+		return NULL;
+	}
+}
+
+/**************************************************************************
+ * BINARY FORMAT DECODERS
+ **************************************************************************/
+
+/* Values are sent in network byte order. Assembling them byte by
+ * byte is endian-independent, and compilers turn it into a single
+ * load and byte swap where the platform has one.
+ */
+#define READ_UINT16(p) \
+	((unsigned short)(((unsigned char *)(p))[0] << 8 | ((unsigned char *)(p))[1]))
+#define READ_UINT32(p) \
+	((unsigned int)((unsigned char *)(p))[0] << 24 | \
+	 (unsigned int)((unsigned char *)(p))[1] << 16 | \
+	 (unsigned int)((unsigned char *)(p))[2] << 8 | \
+	 (unsigned int)((unsigned char *)(p))[3])
+#define READ_UINT64(p) \
+	((unsigned LONG_LONG)READ_UINT32(p) << 32 | READ_UINT32((p) + 4))
+
+static VALUE
+pg_bin_dec_boolean(const char *value, int length)
+{
+	if(length != 1)
+		return Qundef;
+	return *value ? Qtrue : Qfalse;
+}
+
+static VALUE
+pg_bin_dec_int2(const char *value, int length)
+{
+	if(length != 2)
+		return Qundef;
+	return INT2FIX((short)READ_UINT16(value));
+}
+
+static VALUE
+pg_bin_dec_int4(const char *value, int length)
+{
+	if(length != 4)
+		return Qundef;
+	return INT2NUM((int)READ_UINT32(value));
+}
+
+static VALUE
+pg_bin_dec_int8(const char *value, int length)
+{
+	if(length != 8)
+		return Qundef;
+	return LL2NUM((LONG_LONG)READ_UINT64(value));
+}
+
+static VALUE
+pg_bin_dec_oid(const char *value, int length)
+{
+	if(length != 4)
+		return Qundef;
+	return UINT2NUM(READ_UINT32(value));
+}
+
+static VALUE
+pg_bin_dec_float4(const char *value, int length)
+{
+	union { unsigned int i; float f; } swap;
+
+	if(length != 4)
+		return Qundef;
+	swap.i = READ_UINT32(value);
+	return rb_float_new(swap.f);
+}
+
+static VALUE
+pg_bin_dec_float8(const char *value, int length)
+{
+	union { unsigned LONG_LONG i; double f; } swap;
+
+	if(length != 8)
+		return Qundef;
+	swap.i = READ_UINT64(value);
+	return rb_float_new(swap.f);
+}
+
+/*
+ * date: days since 2000-01-01. The extreme values stand for
+ * -infinity and infinity, which Date can't represent.
+ */
+static VALUE
+pg_bin_dec_date(const char *value, int length)
+{
+	int days, year, month, day;
+
+	if(length != 4)
+		return Qundef;
+	days = (int)READ_UINT32(value);
+	if(days == (int)0x7FFFFFFF || days == (int)0x80000000)
+		return Qundef;
+	civil_from_days(days + POSTGRES_EPOCH_DAYS, &year, &month, &day);
+	return new_date(year, month, day);
+}
+
+/*
+ * timestamp and timestamptz: microseconds since 2000-01-01 00:00 UTC
+ * for servers with integer_datetimes, otherwise a double in seconds.
+ */
+static VALUE
+pg_bin_dec_timestamptz(const char *value, int length)
+{
+	LONG_LONG usecs, secs;
+
+	if(length != 8)
+		return Qundef;
+	usecs = (LONG_LONG)READ_UINT64(value);
+	if(usecs == (LONG_LONG)0x7FFFFFFFFFFFFFFFLL || usecs == -(LONG_LONG)0x7FFFFFFFFFFFFFFFLL - 1)
+		return Qundef;
+	secs = usecs / 1000000;
+	usecs %= 1000000;
+	if(usecs < 0) {
+		secs--;
+		usecs += 1000000;
+	}
+	return rb_time_new((time_t)(secs + POSTGRES_EPOCH_SECS), (long)usecs);
+}
+
+static VALUE
+pg_bin_dec_timestamptz_float(const char *value, int length)
+{
+	union { unsigned LONG_LONG i; double f; } swap;
+	double secs, whole;
+
+	if(length != 8)
+		return Qundef;
+	swap.i = READ_UINT64(value);
+	secs = swap.f;
+	if(secs != secs || secs > 1e18 || secs < -1e18)
+		return Qundef;
+	whole = floor(secs);
+	return rb_time_new((time_t)whole + POSTGRES_EPOCH_SECS, 
+		(long)((secs - whole) * 1e6 + 0.5));
+}
+
+static VALUE
+pg_bin_dec_timestamp(const char *value, int length)
+{
+	VALUE time = pg_bin_dec_timestamptz(value, length);
+	return time == Qundef ? Qundef : rb_funcall(time, id_utc, 0);
+}
+
+static VALUE
+pg_bin_dec_timestamp_float(const char *value, int length)
+{
+	VALUE time = pg_bin_dec_timestamptz_float(value, length);
+	return time == Qundef ? Qundef : rb_funcall(time, id_utc, 0);
+}
+
+/*
+ * interval: the time part in microseconds (or seconds as a double 
+ * without integer_datetimes), then days and months.
+ */
+static VALUE
+pg_bin_dec_interval(const char *value, int length)
+{
+	if(length != 16)
+		return Qundef;
+	return interval_seconds((LONG_LONG)READ_UINT64(value) / 1e6,
+		(int)READ_UINT32(value + 8), (int)READ_UINT32(value + 12));
+}
+
+static VALUE
+pg_bin_dec_interval_float(const char *value, int length)
+{
+	union { unsigned LONG_LONG i; double f; } swap;
+
+	if(length != 16)
+		return Qundef;
+	swap.i = READ_UINT64(value);
+	return interval_seconds(swap.f, (int)READ_UINT32(value + 8), 
+		(int)READ_UINT32(value + 12));
+}
+
+/*
+ * uuid: 16 bytes, returned in the canonical text form, as the
+ * server's text output already is.
+ */
+static VALUE
+pg_bin_dec_uuid(const char *value, int length)
+{
+	static const char hex[] = "0123456789abcdef";
+	char out[36];
+	int i, n = 0;
+
+	if(length != 16)
+		return Qundef;
+	for(i = 0; i < 16; i++) {
+		if(i == 4 || i == 6 || i == 8 || i == 10)
+			out[n++] = '-';
+		out[n++] = hex[(unsigned char)value[i] >> 4];
+		out[n++] = hex[(unsigned char)value[i] & 0x0F];
+	}
+	return rb_str_new(out, 36);
+}
+
+/*
+ * inet and cidr: address family (2 for IPv4, 3 for IPv6), netmask
+ * bits, the cidr flag, the address length and the address. As for
+ * text, an inet with a netmask is returned as a String, here in the
+ * text form the server would have sent.
+ */
+static VALUE
+pg_bin_dec_inet(const char *value, int length)
+{
+	int ipv6, bits, nb;
+	VALUE addr, ip;
+	char suffix[5];
+
+	if(length < 4)
+		return Qundef;
+	ipv6 = value[0] == 3;
+	bits = (unsigned char)value[1];
+	nb = (unsigned char)value[3];
+	if(nb != (ipv6 ? 16 : 4) || length != 4 + nb || bits > nb * 8)
+		return Qundef;
+	if(ipv6) {
+		addr = rb_funcall(ULL2NUM(READ_UINT64(value + 4)), id_lshift, 1, 
+			INT2FIX(64));
+		addr = rb_funcall(addr, id_or, 1, ULL2NUM(READ_UINT64(value + 12)));
+	}
+	else {
+		addr = UINT2NUM(READ_UINT32(value + 4));
+	}
+	if(value[2] || bits == nb * 8)
+		return new_ipaddr(addr, ipv6, bits);
+
+	ip = rb_obj_as_string(new_ipaddr(addr, ipv6, nb * 8));
+	snprintf(suffix, sizeof(suffix), "/%d", bits);
+	return rb_str_cat2(ip, suffix);
+}
+
+/*
+ * Returns the decoder for binary format values of type _type_, or
+ * NULL if the raw bytes are best returned as a String (as for
+ * +bytea+ and +text+). _integer_datetimes_ is the server setting of
+ * the same name, which determines the timestamp representation.
+ */
+t_pg_decoder
+pg_bin_decoder(Oid type, int integer_datetimes)
+{
+	switch(type) {
+	case BOOLOID:
+		return pg_bin_dec_boolean;
+	case INT2OID:
+		return pg_bin_dec_int2;
+	case INT4OID:
+		return pg_bin_dec_int4;
+	case INT8OID:
+		return pg_bin_dec_int8;
+	case OIDOID:
+		return pg_bin_dec_oid;
+	case FLOAT4OID:
+		return pg_bin_dec_float4;
+	case FLOAT8OID:
+		return pg_bin_dec_float8;
+	case DATEOID:
+		return pg_bin_dec_date;
+	case TIMESTAMPOID:
+		return integer_datetimes ? 
+			pg_bin_dec_timestamp : pg_bin_dec_timestamp_float;
+	case TIMESTAMPTZOID:
+		return integer_datetimes ? 
+			pg_bin_dec_timestamptz : pg_bin_dec_timestamptz_float;
+	case INTERVALOID:
+		return integer_datetimes ? 
+			pg_bin_dec_interval : pg_bin_dec_interval_float;
+	case UUIDOID:
+		return pg_bin_dec_uuid;
+	case INETOID:
+	case CIDROID:
+		return pg_bin_dec_inet;
+	default:
+		return NULL;
+	}
+}
+
+/**************************************************************************
+ * TEXT FORMAT ENCODERS
+ **************************************************************************/
+
+int
+pg_text_enc_integer(long val, char *out)
+{
+	char digits[24];
+	unsigned long u = val < 0 ? 0 - (unsigned long)val : (unsigned long)val;
+	int n = 0, len = 0;
+
+	do {
+		digits[n++] = (char)('0' + u % 10);
+		u /= 10;
+	} while(u > 0);
+	if(val < 0)
+		out[len++] = '-';
+	while(n > 0)
+		out[len++] = digits[--n];
+	out[len] = '\0';
+	return len;
+}
+
+/*
+ * The shortest of 15 or 17 significant digits that reads back as the
+ * same double; the special values are spelled the way the server 
+ * expects them.
+ */
+int
+pg_text_enc_float(double val, char *out)
+{
+	int len;
+
+	if(val != val) {
+		memcpy(out, "NaN", 4);
+		return 3;
+	}
+	if(val > 0 && val * 0.5 == val) {
+		memcpy(out, "Infinity", 9);
+		return 8;
+	}
+	if(val < 0 && val * 0.5 == val) {
+		memcpy(out, "-Infinity", 10);
+		return 9;
+	}
+	len = snprintf(out, PG_ENC_BUFSIZE, "%.15g", val);
+	if(strtod(out, NULL) != val)
+		len = snprintf(out, PG_ENC_BUFSIZE, "%.17g", val);
+	return len;
+}
+
+static int
+enc_date_parts(long days, char *out)
+{
+	int year, month, day;
+
+	civil_from_days(days, &year, &month, &day);
+	if(year < 1 || year > 9999)
+		return -1;
+	return snprintf(out, PG_ENC_BUFSIZE, "%04d-%02d-%02d", year, month, day);
+}
+
+/*
+ * A Time, as a timestamp with time zone in UTC with microseconds, 
+ * e.g. "2009-01-26 12:34:56.500000+00".
+ */
+int
+pg_text_enc_time(VALUE time, char *out)
+{
+	struct timeval tv = rb_time_timeval(time);
+	long days = (long)(tv.tv_sec / 86400);
+	long secs = (long)(tv.tv_sec % 86400);
+	int len;
+
+	if(secs < 0) {
+		secs += 86400;
+		days--;
+	}
+	if((len = enc_date_parts(days, out)) < 0)
+		return -1;
+	return len + snprintf(out + len, PG_ENC_BUFSIZE - len, 
+		" %02ld:%02ld:%02ld.%06ld+00", secs / 3600, secs / 60 % 60, secs % 60,
+		(long)tv.tv_usec);
+}
+
+/*
+ * A Date (but not a DateTime, which has a time of day as well).
+ */
+int
+pg_text_enc_date(VALUE date, char *out)
+{
+	if(NIL_P(rb_cDate) && rb_const_defined(rb_cObject, rb_intern("Date")))
+		rb_cDate = rb_const_get(rb_cObject, rb_intern("Date"));
+	if(NIL_P(rb_cDate) || rb_obj_class(date) != rb_cDate)
+		return -1;
+	/* the Julian day number of 1970-01-01 is 2440588 */
+	return enc_date_parts(NUM2LONG(rb_funcall(date, id_jd, 0)) - 2440588, out);
+}
+
+/**************************************************************************
+ * TYPE NAMES
+ **************************************************************************/
+
+/*
+ * Enum labels are the same in text and binary format, and a small 
+ * set of values, so they are interned as Symbols. libpq terminates
+ * every value with a NUL byte.
+ */
+VALUE
+pg_dec_symbol(const char *value, int length)
+{
+	return ID2SYM(rb_intern(value));
+}
+
+/*
+ * Arrays of enums and of hstore, whose oids are only known from the
+ * catalog (see PGconn#type_catalog).
+ */
+VALUE
+pg_text_dec_symbol_array(const char *value, int length)
+{
+	return pg_text_dec_array(value, length, pg_dec_symbol, ',');
+}
+
+VALUE
+pg_text_dec_hstore_array(const char *value, int length)
+{
+	return pg_text_dec_array(value, length, pg_text_dec_hstore, ',');
+}
+
+/* The types with decoders, by their pg_type.typname */
+static struct {
+	const char *name;
+	Oid type;
+	ID id;
+} builtin_types[] = {
+	{ "bool", BOOLOID }, { "bytea", BYTEAOID }, { "int2", INT2OID },
+	{ "int4", INT4OID }, { "int8", INT8OID }, { "oid", OIDOID }, 
+	{ "float4", FLOAT4OID }, { "float8", FLOAT8OID }, { "date", DATEOID },
+	{ "timestamp", TIMESTAMPOID }, { "timestamptz", TIMESTAMPTZOID },
+	{ "interval", INTERVALOID }, { "inet", INETOID }, { "cidr", CIDROID },
+	{ "uuid", UUIDOID }, { "record", RECORDOID },
+	{ "_bool", BOOLARRAYOID }, { "_bytea", BYTEAARRAYOID }, 
+	{ "_name", NAMEARRAYOID }, { "_int2", INT2ARRAYOID }, 
+	{ "_int4", INT4ARRAYOID }, { "_text", TEXTARRAYOID }, 
+	{ "_bpchar", BPCHARARRAYOID }, { "_varchar", VARCHARARRAYOID }, 
+	{ "_int8", INT8ARRAYOID }, { "_float4", FLOAT4ARRAYOID }, 
+	{ "_float8", FLOAT8ARRAYOID }, { "_oid", OIDARRAYOID }, 
+	{ "_timestamp", TIMESTAMPARRAYOID }, { "_date", DATEARRAYOID }, 
+	{ "_timestamptz", TIMESTAMPTZARRAYOID }
+};
+
+#define NUM_BUILTIN_TYPES (int)(sizeof(builtin_types) / sizeof(builtin_types[0]))
+
+/*
+ * Returns the oid of the built-in type named _name_ (as a Symbol's
+ * ID), or InvalidOid if the extension has no decoder for it.
+ */
+Oid
+pg_builtin_type_oid(ID name)
+{
+	int i;
+	for(i = 0; i < NUM_BUILTIN_TYPES; i++) {
+		if(builtin_types[i].id == name)
+			return builtin_types[i].type;
+	}
+	return InvalidOid;
+}
+
+/*
+ * Returns a new Hash mapping the oid of each built-in type with a 
+ * decoder to its name as a Symbol.
+ */
+VALUE
+pg_builtin_types(void)
+{
+	VALUE hash = rb_hash_new();
+	int i;
+	for(i = 0; i < NUM_BUILTIN_TYPES; i++) {
+		rb_hash_aset(hash, UINT2NUM(builtin_types[i].type), 
+			ID2SYM(builtin_types[i].id));
+	}
+	return hash;
+}
+
+/* The built-in types that bind parameters can be given by name, by 
+ * their pg_type.typname, with the oids of the types and their arrays */
+static const struct {
+	const char *name;
+	Oid type;
+	Oid array_type;
+} param_types[] = {
+	{ "bool", 16, 1000 }, { "bytea", 17, 1001 }, { "char", 18, 1002 },
+	{ "name", 19, 1003 }, { "int8", 20, 1016 }, { "int2", 21, 1005 },
+	{ "int4", 23, 1007 }, { "text", 25, 1009 }, { "oid", 26, 1028 },
+	{ "json", 114, 199 }, { "xml", 142, 143 }, { "cidr", 650, 651 },
+	{ "float4", 700, 1021 }, { "float8", 701, 1022 }, { "money", 790, 791 },
+	{ "macaddr", 829, 1040 }, { "inet", 869, 1041 }, { "bpchar", 1042, 1014 },
+	{ "varchar", 1043, 1015 }, { "date", 1082, 1182 }, { "time", 1083, 1183 },
+	{ "timestamp", 1114, 1115 }, { "timestamptz", 1184, 1185 },
+	{ "interval", 1186, 1187 }, { "timetz", 1266, 1270 }, { "bit", 1560, 1561 },
+	{ "varbit", 1562, 1563 }, { "numeric", 1700, 1231 }, { "record", 2249, 2287 },
+	{ "uuid", 2950, 2951 }, { "jsonb", 3802, 3807 }
+};
+
+#define NUM_PARAM_TYPES (int)(sizeof(param_types) / sizeof(param_types[0]))
+
+/*
+ * Returns the oid of the built-in type named _name_, or InvalidOid if
+ * it isn't one of param_types. Arrays are named with a leading '_', as
+ * in pg_type, or a trailing "[]", as in SQL.
+ */
+Oid
+pg_param_type_oid(const char *name)
+{
+	size_t len = strlen(name);
+	int array = 0, i;
+
+	if(name[0] == '_') {
+		array = 1;
+		name++;
+		len--;
+	}
+	else if(len > 2 && strcmp(name + len - 2, "[]") == 0) {
+		array = 1;
+		len -= 2;
+	}
+	for(i = 0; i < NUM_PARAM_TYPES; i++) {
+		if(strlen(param_types[i].name) == len && 
+				strncmp(param_types[i].name, name, len) == 0)
+			return array ? param_types[i].array_type : param_types[i].type;
+	}
+	return InvalidOid;
+}
+
+/*
+ * Returns a new Hash mapping the name of each type in param_types 
+ * and of its array, as Symbols, to its oid.
+ */
+VALUE
+pg_param_types(void)
+{
+	VALUE hash = rb_hash_new();
+	char name[32];
+	int i;
+	for(i = 0; i < NUM_PARAM_TYPES; i++) {
+		rb_hash_aset(hash, ID2SYM(rb_intern(param_types[i].name)), 
+			UINT2NUM(param_types[i].type));
+		snprintf(name, sizeof(name), "_%s", param_types[i].name);
+		rb_hash_aset(hash, ID2SYM(rb_intern(name)), 
+			UINT2NUM(param_types[i].array_type));
+	}
+	return hash;
+}
+
+void
+Init_pg_typecast()
+{
+	int i;
+
+	rb_global_variable(&rb_cDate);
+	rb_global_variable(&rb_cIPAddr);
+	rb_global_variable(&af_inet);
+	rb_global_variable(&af_inet6);
+	id_new = rb_intern("new");
+	id_utc = rb_intern("utc");
+	id_mask = rb_intern("mask");
+	id_lshift = rb_intern("<<");
+	id_or = rb_intern("|");
+	id_jd = rb_intern("jd");
+	for(i = 0; i < NUM_BUILTIN_TYPES; i++)
+		builtin_types[i].id = rb_intern(builtin_types[i].name);
+}
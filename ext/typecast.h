@@ -0,0 +1,90 @@
+#ifndef __typecast_h
+#define __typecast_h
+
+#include "ruby.h"
+#include "libpq-fe.h"
+
+#ifndef RB_GC_GUARD
+#define RB_GC_GUARD(v) (*(volatile VALUE *)&(v))
+#endif /* RB_GC_GUARD */
+
+/* Type oids of the built-in types we know how to decode. These
+ * come from catalog/pg_type.h, which is only installed with the
+ * server headers.
+ */
+#define BOOLOID         16
+#define BYTEAOID        17
+#define NAMEOID         19
+#define INT8OID         20
+#define INT2OID         21
+#define INT4OID         23
+#define TEXTOID         25
+#define OIDOID          26
+#define CIDROID         650
+#define FLOAT4OID       700
+#define FLOAT8OID       701
+#define INETOID         869
+#define BPCHAROID       1042
+#define VARCHAROID      1043
+#define DATEOID         1082
+#define TIMESTAMPOID    1114
+#define TIMESTAMPTZOID  1184
+#define INTERVALOID     1186
+#define RECORDOID       2249
+#define UUIDOID         2950
+
+/* Array types of the above */
+#define BOOLARRAYOID        1000
+#define BYTEAARRAYOID       1001
+#define NAMEARRAYOID        1003
+#define INT2ARRAYOID        1005
+#define INT4ARRAYOID        1007
+#define TEXTARRAYOID        1009
+#define BPCHARARRAYOID      1014
+#define VARCHARARRAYOID     1015
+#define INT8ARRAYOID        1016
+#define FLOAT4ARRAYOID      1021
+#define FLOAT8ARRAYOID      1022
+#define OIDARRAYOID         1028
+#define TIMESTAMPARRAYOID   1115
+#define DATEARRAYOID        1182
+#define TIMESTAMPTZARRAYOID 1185
+
+/* A decoder turns the raw bytes of a non-NULL value, as returned by
+ * PQgetvalue() and PQgetlength(), into a ruby object. It returns
+ * Qundef if it can't make sense of the value, in which case the
+ * caller falls back to returning the value as a String.
+ */
+typedef VALUE (*t_pg_decoder)(const char *value, int length);
+
+t_pg_decoder pg_text_decoder(Oid type);
+t_pg_decoder pg_bin_decoder(Oid type, int integer_datetimes);
+t_pg_decoder pg_text_array_decoder(Oid type);
+VALUE pg_text_dec_array(const char *value, int length, t_pg_decoder element, char delim);
+VALUE pg_text_dec_record(const char *value, int length);
+VALUE pg_text_dec_hstore(const char *value, int length);
+VALUE pg_text_enc_hstore(VALUE hash);
+VALUE pg_text_enc_array(VALUE ary);
+VALUE pg_dec_symbol(const char *value, int length);
+VALUE pg_text_dec_symbol_array(const char *value, int length);
+VALUE pg_text_dec_hstore_array(const char *value, int length);
+Oid pg_builtin_type_oid(ID name);
+VALUE pg_builtin_types(void);
+Oid pg_param_type_oid(const char *name);
+VALUE pg_param_types(void);
+
+/* Encoders write the text form of a bind parameter into a buffer of
+ * PG_ENC_BUFSIZE bytes, NUL-terminated since libpq takes the length of
+ * text parameters from strlen(), and return its length, or -1 if the 
+ * value can't be encoded that way.
+ */
+#define PG_ENC_BUFSIZE 40
+
+int pg_text_enc_integer(long val, char *out);
+int pg_text_enc_float(double val, char *out);
+int pg_text_enc_time(VALUE time, char *out);
+int pg_text_enc_date(VALUE date, char *out);
+
+void Init_pg_typecast(void);
+
+#endif /* __typecast_h */
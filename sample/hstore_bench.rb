@@ -0,0 +1,39 @@
+#! /usr/bin/env ruby
+#
+# Compares decoding and encoding hstore values with the C functions
+# against the usual regex-based Ruby implementation.
+#
+require 'pg'
+require 'benchmark'
+
+HSTORE_PAIR = /"((?:[^"\\]|\\.)*)"\s*=>\s*(NULL|"((?:[^"\\]|\\.)*)")/
+
+def ruby_decode(str)
+  hash = {}
+  str.scan(HSTORE_PAIR) do |key, null, value|
+    hash[key.gsub(/\\(.)/, '\1')] = null == 'NULL' ? nil : value.gsub(/\\(.)/, '\1')
+  end
+  hash
+end
+
+def ruby_quote(str)
+  '"' + str.to_s.gsub(/(["\\])/, '\\\\\1') + '"'
+end
+
+def ruby_encode(hash)
+  hash.map { |k, v| "#{ruby_quote(k)}=>#{v.nil? ? 'NULL' : ruby_quote(v)}" }.join(', ')
+end
+
+count = (ARGV[0] || 100_000).to_i
+
+hash = {}
+20.times { |i| hash["key #{i}"] = i.odd? ? nil : %[value "#{i}" \\ #{'x' * i}] }
+str = PGconn.encode_hstore(hash)
+raise "decoders disagree" unless ruby_decode(str) == PGconn.decode_hstore(str)
+
+Benchmark.bmbm(14) do |x|
+  x.report("ruby decode") { count.times { ruby_decode(str) } }
+  x.report("C decode") { count.times { PGconn.decode_hstore(str) } }
+  x.report("ruby encode") { count.times { ruby_encode(hash) } }
+  x.report("C encode") { count.times { PGconn.encode_hstore(hash) } }
+end
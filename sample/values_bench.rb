@@ -0,0 +1,23 @@
+#! /usr/bin/env ruby
+#
+# Compares materializing a large result with PGresult#values
+# against building a Hash per tuple with #each and #[].
+#
+require 'pg'
+require 'benchmark'
+
+dbname = ARGV[0] || "template1"
+ntuples = (ARGV[1] || 200_000).to_i
+
+conn = PGconn.connect(:dbname => dbname)
+res = conn.exec(%[SELECT g AS id, 'name ' || g AS name, g * 1.5 AS score,
+  NULL AS missing FROM generate_series(1, #{ntuples}) AS g])
+
+Benchmark.bmbm(8) do |x|
+  x.report("each") { rows = []; res.each { |tuple| rows << tuple } }
+  x.report("[]") { (0...res.ntuples).map { |i| res[i] } }
+  x.report("values") { res.values }
+end
+
+res.clear
+conn.finish
@@ -1,11 +1,18 @@
 require 'rubygems'
 require 'spec'
+require 'date'
 
 $LOAD_PATH.unshift('ext')
 require 'pg'
 
 describe PGconn do
 
+	# resident set size in KB, or nil where /proc isn't available
+	def rss_kb
+		return nil unless File.exist?("/proc/self/status")
+		File.read("/proc/self/status")[/VmRSS:\s+(\d+)/, 1].to_i
+	end
+
 	before( :all ) do
 		puts "======  TESTING PGconn  ======"
 		@test_directory = "#{Dir.getwd}/tmp_test_#{rand}"
@@ -110,6 +117,161 @@ describe PGconn do
 		error.should == true
 	end
 
+	it "should yield streamed tuples before the query has completed" do
+		count = 0
+		lambda {
+			@conn.stream("SELECT CASE WHEN g < 1000 THEN g ELSE 1 / (g - 1000) END FROM generate_series(1, 1000) AS g") do |tuple|
+				count += 1
+			end
+		}.should raise_error(PGError)
+		# a buffered result would fail without yielding any tuple
+		count.should == 999
+		@conn.exec("SELECT 1 AS one")[0]['one'].should == '1'
+	end
+
+	it "should stream a large result with bounded memory" do
+		count = 0
+		@conn.stream("SELECT g, repeat('x', 100) FROM generate_series(1, 1000000) AS g") do |tuple|
+			count += 1
+			if count == 1000
+				GC.start
+				@rss_before = rss_kb
+			end
+		end
+		count.should == 1000000
+		if @rss_before
+			# buffering the whole result would take well over 100MB
+			(rss_kb - @rss_before).should < 64 * 1024
+		end
+	end
+
+	it "should cancel a stream abandoned by the block" do
+		count = 0
+		@conn.stream("SELECT generate_series(1, 1000000)") do |tuple|
+			count += 1
+			break if count == 10
+		end
+		count.should == 10
+		@conn.exec("SELECT 1 AS one")[0]['one'].should == '1'
+	end
+
+	it "should encode and decode hstore literals" do
+		hash = { 'k' => 'v', 'a "b"' => nil, 'c\\d' => '' }
+		PGconn.decode_hstore(PGconn.encode_hstore(hash)).should == hash
+		PGconn.decode_hstore('a=>b, "c"=>NULL').should == { 'a' => 'b', 'c' => nil }
+		lambda { PGconn.decode_hstore('"a"=>') }.should raise_error(ArgumentError)
+		res = @conn.exec("SELECT $1::text AS h", [{ :value => { 'x' => nil } }])
+		res[0]['h'].should == '"x"=>NULL'
+	end
+
+	it "should decode results with the connection's type map" do
+		@conn.exec("CREATE TYPE pg_spec_mood AS ENUM ('sad', 'happy')")
+		begin
+			mood = @conn.exec("SELECT 'pg_spec_mood'::regtype::oid")[0]['oid'].to_i
+			@conn.type_map.update(PGconn::BUILTIN_TYPES)
+			@conn.type_map[mood] = :symbol
+			@conn.type_map[25] = lambda { |s| s.upcase }
+			res = @conn.exec("SELECT 1 AS i, 'happy'::pg_spec_mood AS m, 'x'::text AS t")
+			res.values.should == [ [1, :happy, 'X'] ]
+			@conn.type_map = nil
+			@conn.exec("SELECT 1 AS i")[0]['i'].should == '1'
+			res.getvalue(0, 0).should == 1
+			lambda { @conn.type_map = {23 => :no_such_decoder} }.should raise_error(ArgumentError)
+		ensure
+			@conn.type_map = nil
+			@conn.exec("DROP TYPE pg_spec_mood")
+		end
+	end
+
+	it "should share the type catalog between connections to the same server" do
+		@conn.exec("CREATE TYPE pg_spec_color AS ENUM ('red', 'green')")
+		other = PGconn.connect(@conninfo)
+		begin
+			catalog = @conn.type_catalog(true)
+			other.type_catalog.should equal(catalog)
+			color = @conn.exec("SELECT 'pg_spec_color'::regtype::oid")[0]['oid'].to_i
+			catalog[color].should == :symbol
+			catalog[23].should == :int4
+			other.type_map = other.type_catalog
+			other.exec("SELECT 'red'::pg_spec_color AS c")[0]['c'].should == :red
+		ensure
+			other.finish
+			@conn.exec("DROP TYPE pg_spec_color")
+		end
+	end
+
+	it "should send booleans, times and dates with their types" do
+		t = Time.at(1234567890, 500000)
+		res = @conn.exec("SELECT $1 AS b, $2 AS t, $3 AS d, $4::float8 AS f, $5::int8 AS i",
+			[true, t, Date.new(2009, 1, 26), 0.1, -2**40])
+		res.ftype(0).should == 16
+		res.ftype(1).should == 1184
+		res.ftype(2).should == 1082
+		res[0]['b'].should == 't'
+		@conn.exec("SELECT $1::timestamptz = 'epoch'::timestamptz + interval '1234567890.5 s' AS eq",
+			[t])[0]['eq'].should == 't'
+		res[0]['d'].should == '2009-01-26'
+		res[0]['f'].should == '0.1'
+		res[0]['i'].should == (-2**40).to_s
+	end
+
+	it "should send several Integer and boolean parameters in a row" do
+		res = @conn.exec("SELECT $1::int4 AS a, $2::int8 AS b, $3::bool AS c, $4::bool AS d, $5::int4 AS e, $6::bool AS f",
+			[42, -7, true, false, 1234567, true])
+		res.values.should == [['42', '-7', 't', 'f', '1234567', 't']]
+		res = @conn.exec("SELECT " + (1..20).map { |i| "$#{i}::text" }.join(', '),
+			(1..20).map { |i| i.odd? ? i : false })
+		res.values.first.should == (1..20).map { |i| i.odd? ? i.to_s : 'false' }
+	end
+
+	it "should send Arrays as array literals" do
+		res = @conn.exec("SELECT n FROM generate_series(1, 5) AS n WHERE n = ANY($1) ORDER BY n",
+			[[1, 3, 5, 7]])
+		res.column_values(0).should == ['1', '3', '5']
+		res = @conn.exec("SELECT $1::text[] AS a, $2::int4[] AS m",
+			[['a', 'b"c', nil, 'NULL'], [[1, 2], [3, nil]]])
+		res[0]['a'].should == '{a,"b\\"c",NULL,"NULL"}'
+		res[0]['m'].should == '{{1,2},{3,NULL}}'
+	end
+
+	it "should send :bytea Strings in binary without escaping" do
+		data = (0..255).map { |i| i.chr }.join * 4
+		res = @conn.exec("SELECT $1 AS b, length($1) AS len, $2::int4 AS i",
+			[{:value => data, :type => :bytea}, {:value => '7', :type => :int4}])
+		res.ftype(0).should == 17
+		res[0]['len'].should == '1024'
+		PGconn.unescape_bytea(res[0]['b']).should == data
+		res[0]['i'].should == '7'
+		res = @conn.exec("SELECT $1 AS t, $2 AS n, $3 AS a",
+			[{:value => 'x', :type => :text}, {:value => '1.5', :type => :numeric},
+			{:value => [1, 2], :type => :"int4[]"}])
+		[res.ftype(0), res.ftype(1), res.ftype(2)].should == [25, 1700, 1007]
+		PGconn::PARAM_TYPES[:_int4].should == 1007
+		lambda { @conn.exec("SELECT $1", [{:value => 1, :type => :no_such_type}]) }.should raise_error(ArgumentError)
+	end
+
+	it "should execute prepared statement handles" do
+		stmt = @conn.prepare_statement("pg_spec_stmt", "SELECT $1::int4 + 1 AS n, $2::bytea AS b")
+		stmt.name.should == "pg_spec_stmt"
+		stmt.connection.should equal(@conn)
+		stmt.param_types.should == [23, 17]
+		data = "\000\377'\\"
+		res = stmt.exec(41, data)
+		res[0]['n'].should == '42'
+		PGconn.unescape_bytea(res[0]['b']).should == data
+		lambda { stmt.exec(1) }.should raise_error(ArgumentError)
+		begin
+			@conn.type_map = {23 => :int4}
+			stmt.exec(1, nil)[0]['n'].should == 2
+			PGstatement.new(@conn, "pg_spec_stmt").exec(2, nil)[0]['n'].should == 3
+			stmt.description.clear
+			lambda { stmt.exec(1, nil) }.should raise_error(PGError)
+		ensure
+			@conn.type_map = nil
+			@conn.exec("DEALLOCATE pg_spec_stmt")
+		end
+	end
+
 	after( :all ) do
 		puts ""
 		@conn.finish
@@ -1,5 +1,7 @@
 require 'rubygems'
 require 'spec'
+require 'ipaddr'
+require 'stringio'
 
 $LOAD_PATH.unshift('ext')
 require 'pg'
@@ -91,6 +93,177 @@ describe PGconn do
 		out_bytes.should== in_bytes
 	end
 
+	it "should return all tuples as arrays with #values" do
+		res = @conn.exec("SELECT 1 AS a, 'x' AS b, NULL AS c UNION ALL SELECT 2, 'y', 3")
+		res.values.should== [ ['1', 'x', nil], ['2', 'y', '3'] ]
+		res.values(1).should== [ ['2', 'y', '3'] ]
+		res.values(0, 1).should== [ ['1', 'x', nil] ]
+		res.values(2).should== []
+	end
+
+	it "should share frozen field name keys between tuples" do
+		res = @conn.exec("SELECT 1 AS a UNION ALL SELECT 2")
+		res[0].keys.first.should be_frozen
+		res[0].keys.first.should equal(res[1].keys.first)
+		res.field_name_type = :symbol
+		res.map { |tuple| tuple[:a] }.should== ['1', '2']
+	end
+
+	it "should return a single column with #column_values and #field_values" do
+		res = @conn.exec("SELECT 1 AS a, 'x' AS b UNION ALL SELECT 2, NULL")
+		res.column_values(0).should== ['1', '2']
+		res.field_values('b').should== ['x', nil]
+		lambda { res.column_values(2) }.should raise_error(ArgumentError)
+		lambda { res.field_values('c') }.should raise_error(ArgumentError)
+	end
+
+	it "should decode built-in types with the :builtin type map" do
+		res = @conn.exec(%[SELECT 't'::bool AS b, 42 AS i, '-9223372036854775808'::int8 AS l,
+			1.5::float8 AS f, '2009-01-26'::date AS d, 
+			'2009-01-26 12:34:56.5'::timestamp AS ts, 'x'::text AS t, NULL::int AS n])
+		res.type_map = :builtin
+		res[0]['b'].should== true
+		res[0]['i'].should== 42
+		res[0]['l'].should== -9223372036854775808
+		res[0]['f'].should== 1.5
+		res[0]['d'].should== Date.new(2009, 1, 26)
+		res[0]['ts'].should== Time.utc(2009, 1, 26, 12, 34, 56.5)
+		res[0]['t'].should== 'x'
+		res[0]['n'].should== nil
+		res.type_map = nil
+		res.getvalue(0, 1).should== '42'
+	end
+
+	it "should decode binary format results with the :builtin type map" do
+		res = @conn.exec(%[SELECT $1::int2 AS s, $1::int4 AS i, $1::int8 AS l,
+			$1::float8 AS f, 'f'::bool AS b, '2009-01-26'::date AS d,
+			'2009-01-26 12:34:56.5'::timestamp AS ts], [-42], 1)
+		res.type_map = :builtin
+		res.values.should== [ [ -42, -42, -42, -42.0, false, Date.new(2009, 1, 26),
+			Time.utc(2009, 1, 26, 12, 34, 56.5) ] ]
+	end
+
+	it "should yield lazy PGrow objects with #each_row" do
+		res = @conn.exec("SELECT 1 AS a, 'x' AS b UNION ALL SELECT 2, NULL")
+		rows = []
+		res.each_row { |row| rows << row }
+		rows.map { |row| row[0] }.should== ['1', '2']
+		rows.map { |row| row['b'] }.should== ['x', nil]
+		rows[0].to_a.should== ['1', 'x']
+		rows[1].to_h.should== { 'a' => '2', 'b' => nil }
+		rows[0].result.should equal(res)
+	end
+
+	it "should report the memory held by the result" do
+		res = @conn.exec("SELECT repeat('x', 1000) FROM generate_series(1, 1000)")
+		res.memsize.should > 1000 * 1000
+		res.clear
+		lambda { res.memsize }.should raise_error(PGError)
+	end
+
+	it "should refill one array for every tuple with #each_row_reuse" do
+		res = @conn.exec("SELECT 1 AS a, 'x' AS b UNION ALL SELECT 2, NULL")
+		arrays = []
+		values = []
+		res.each_row_reuse do |ary|
+			arrays << ary
+			values << ary.dup
+		end
+		values.should== [ ['1', 'x'], ['2', nil] ]
+		arrays[0].should equal(arrays[1])
+	end
+
+	it "should only read the requested fields with the :fields option" do
+		res = @conn.exec("SELECT 1 AS a, 2 AS b, 3 AS c")
+		res.values(:fields => ['c', 0]).should== [ ['3', '1'] ]
+		tuples = []
+		res.each(:fields => [:b]) { |tuple| tuples << tuple }
+		tuples.should== [ { 'b' => '2' } ]
+		lambda { res.values(:fields => ['d']) }.should raise_error(ArgumentError)
+	end
+
+	it "should decode text format bytea with the :builtin type map" do
+		bytes = File.open('spec/data/random_binary_data').read
+		res = @conn.exec('VALUES ($1::bytea)', [ { :value => bytes, :format => 1 } ])
+		res.type_map = :builtin
+		res[0]['column1'].should== bytes
+	end
+
+	it "should parse array literals with #array_values and the :builtin type map" do
+		res = @conn.exec(%[SELECT ARRAY[1, NULL, 3] AS i, 
+			ARRAY['a b', 'c"d', NULL, 'NULL'] AS t, ARRAY[[1.5, 2], [3, 4]]::float8[] AS f])
+		res.array_values(0).should== [ [1, nil, 3] ]
+		res.array_values(1).should== [ ['a b', 'c"d', nil, 'NULL'] ]
+		res.type_map = :builtin
+		res[0]['f'].should== [ [1.5, 2.0], [3.0, 4.0] ]
+		lambda { @conn.exec("SELECT 'x' AS s").array_values(0) }.should raise_error(ArgumentError)
+	end
+
+	it "should parse composite values with #record_values and #record_hashes" do
+		@conn.exec("CREATE TYPE pg_spec_pair AS (id integer, label text)")
+		begin
+			res = @conn.exec(%[SELECT ROW(1, 'a "b"', NULL)::record AS r,
+				ROW(2, '')::pg_spec_pair AS p])
+			res.record_values(0).should== [ ['1', 'a "b"', nil] ]
+			res.record_values(1).should== [ ['2', ''] ]
+			res.record_hashes(1).should== [ { 'id' => '2', 'label' => '' } ]
+			res.field_name_type = :symbol
+			res.record_hashes(1).should== [ { :id => '2', :label => '' } ]
+			lambda { res.record_hashes(0) }.should raise_error(ArgumentError)
+		ensure
+			@conn.exec("DROP TYPE pg_spec_pair")
+		end
+	end
+
+	it "should decode uuid, inet, cidr and interval with the :builtin type map" do
+		sql = %[SELECT 'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11'::uuid AS u,
+			'10.1.2.3'::inet AS i, '10.1.2.3/24'::inet AS n, '10.1.0.0/16'::cidr AS c,
+			'1 day 01:00:00.5'::interval AS v]
+		expected = [ 'a0eebc99-9c0b-4ef8-bb6d-6bb9bd380a11', IPAddr.new('10.1.2.3'),
+			'10.1.2.3/24', IPAddr.new('10.1.0.0/16'), 90000.5 ]
+		[0, 1].each do |format|
+			res = @conn.exec(sql, [], format)
+			res.type_map = :builtin
+			res.values.should== [ expected ]
+		end
+	end
+
+	it "should write the result as CSV with #write_csv" do
+		res = @conn.exec(%[SELECT 1 AS id, 'a,b' AS s, NULL AS n UNION ALL
+			SELECT 2, 'say "hi"', ''])
+		io = StringIO.new
+		res.write_csv(io, :header => true)
+		io.string.should== %[id,s,n\n1,"a,b",\n2,"say ""hi""",""\n]
+		io = StringIO.new
+		res.write_csv(io, :delimiter => "\t", :null => '\\N')
+		io.string.should== %[1\ta,b\t\\N\n2\t"say ""hi"""\t\n]
+	end
+
+	it "should round-trip through #dump and PGresult.load" do
+		res = @conn.exec(%[SELECT 1 AS i, 'a b' AS s, NULL AS n UNION ALL
+			SELECT 2, '', 'x'])
+		copy = PGresult.load(res.dump)
+		copy.fields.should== res.fields
+		copy.ftype(0).should== res.ftype(0)
+		copy.values.should== res.values
+		copy.getisnull(0, 2).should== true
+		copy.type_map = :builtin
+		copy[1].should== { 'i' => 2, 's' => '', 'n' => 'x' }
+		lambda { PGresult.load('junk') }.should raise_error(ArgumentError)
+	end
+
+	it "should build Hashes keyed by a field with #index_by_field and #group_by_field" do
+		res = @conn.exec(%[SELECT 1 AS id, 'a' AS name UNION ALL
+			SELECT 2, 'b' UNION ALL SELECT 1, 'c'])
+		res.index_by_field('id').should== { '1' => { 'id' => '1', 'name' => 'c' },
+			'2' => { 'id' => '2', 'name' => 'b' } }
+		res.index_by_field(0, :typed => true, :fields => ['name']).should==
+			{ 1 => { 'name' => 'c' }, 2 => { 'name' => 'b' } }
+		res.group_by_field('id', :fields => ['name']).should==
+			{ '1' => [ { 'name' => 'a' }, { 'name' => 'c' } ], '2' => [ { 'name' => 'b' } ] }
+		res.group_by { |tuple| tuple['name'] == 'b' }.keys.sort_by { |k| k.to_s }.should== [false, true]
+	end
+
 	after( :all ) do
 		puts ""
 		@conn.finish